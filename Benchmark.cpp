@@ -0,0 +1,741 @@
+/******************************************************************************/
+/*!
+\file   Benchmark.cpp
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+Benchmarks of the KDTree on synthetic data sets. For every distribution and
+dimension asked for it times the build, the insertion of points one by one,
+the latency of single queries, the throughput of query batches, searched one
+query at a time and with a dual tree, the self join of the points, a forest of
+shards built, queried and saved on several threads, and the serialization of
+the tree in both formats. The results are written as JSON or
+CSV so that runs can be compared from one change to the next.
+
+Usage: Benchmark [options]
+  --points N          points in each data set (100000)
+  --queries N         queries run against each tree (10000)
+  --dims A,B,...      dimensions to run (2,3,8)
+  --distributions ... uniform, clustered, sorted and/or elongated (uniform,clustered,sorted)
+  --k N               neighbors per query (10)
+  --bucket N          points per leaf (16)
+  --split S           cycle, variance, spread or midpoint split rule (cycle)
+  --layout L          build, preorder, blocked or veb order of the nodes (build)
+  --threads N         threads of the batch queries, 0 for all (0)
+  --repeat N          runs of each timed step, the median is kept (3)
+  --seed N            seed of the generators (1)
+  --type T            float or double (double)
+  --metric M          l2, squared_l2, l1, linf or weighted_l2 (l2)
+  --precision P       full, float32, float16, int16 or int8 copy searched by the queries (full)
+  --candidates N      candidates per neighbor re-ranked at full precision (2)
+  --shards N          shards of the forest benchmarked, 0 to skip it (8)
+  --format F          json or csv (json)
+  --output FILE       where to write the results (standard output)
+  --dir DIR           where to write the temporary tree files (current directory)
+
+*/
+/******************************************************************************/
+
+#include "KDTree.h"
+#include "ShardedKDTree.h"
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+	//! settings of a run, read from the command line.
+	struct Options
+	{
+		size_t points;
+		size_t queries;
+		std::vector<unsigned int> dimensions;
+		std::vector<std::string> distributions;
+		size_t k;
+		unsigned int bucket;
+		SplitRule split;
+		std::string splitName;
+		//! relayout is false to keep the order the build gives the nodes.
+		bool relayout;
+		NodeLayout layout;
+		std::string layoutName;
+		unsigned int threads;
+		unsigned int repeat;
+		unsigned int seed;
+		std::string type;
+		std::string metric;
+		CoordinatePrecision precision;
+		std::string precisionName;
+		unsigned int candidates;
+		unsigned int shards;
+		std::string format;
+		std::string output;
+		std::string directory;
+	};
+
+	//! one measurement.
+	struct Result
+	{
+		std::string distribution;
+		unsigned int dimension;
+		std::string benchmark;
+		std::string metric;
+		double value;
+		std::string unit;
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	double elapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+
+	/******************************************************************************/
+	/*!
+
+	Returns the value below which "fraction" of the sorted samples fall.
+
+	*/
+	/******************************************************************************/
+	double percentile(const std::vector<double>& sorted, double fraction)
+	{
+		size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	/******************************************************************************/
+	/*!
+
+	Fills "data" with "count" points of dimension "dim" stored row by row.
+	uniform   - every coordinate uniform in [0, 1).
+	clustered - gaussian clusters of small spread around 32 random centers,
+	            the density varies a lot from one region to the next.
+	sorted    - uniform points sorted along the first coordinate, the worst
+	            order for a tree built by inserting the points one by one.
+	elongated - uniform points whose range shrinks 4 times from one
+	            coordinate to the next, like features of different units.
+
+	*/
+	/******************************************************************************/
+	template <typename T>
+	bool generate(const std::string& distribution, size_t count, unsigned int dim, unsigned int seed, std::vector<T>& data)
+	{
+		std::mt19937_64 generator(seed);
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+		data.resize(count * dim);
+		if (distribution == "uniform" || distribution == "sorted")
+		{
+			for (size_t i = 0; i < data.size(); ++i)
+			{
+				data[i] = static_cast<T>(uniform(generator));
+			}
+			if (distribution == "sorted")
+			{
+				std::vector<size_t> order(count);
+				for (size_t i = 0; i < count; ++i)
+				{
+					order[i] = i;
+				}
+				std::sort(order.begin(), order.end(), [&data, dim](size_t lhs, size_t rhs)
+				{
+					return data[lhs * dim] < data[rhs * dim];
+				});
+				std::vector<T> sorted(data.size());
+				for (size_t i = 0; i < count; ++i)
+				{
+					std::copy(data.begin() + order[i] * dim, data.begin() + (order[i] + 1) * dim, sorted.begin() + i * dim);
+				}
+				data.swap(sorted);
+			}
+			return true;
+		}
+		if (distribution == "elongated")
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				double range = 1.0;
+				for (unsigned int j = 0; j < dim; ++j, range /= 4.0)
+				{
+					data[i * dim + j] = static_cast<T>(uniform(generator) * range);
+				}
+			}
+			return true;
+		}
+		if (distribution == "clustered")
+		{
+			const size_t clusterCount = 32;
+			std::vector<double> centers(clusterCount * dim);
+			for (size_t i = 0; i < centers.size(); ++i)
+			{
+				centers[i] = uniform(generator);
+			}
+			std::normal_distribution<double> spread(0.0, 0.02);
+			std::uniform_int_distribution<size_t> pick(0, clusterCount - 1);
+			for (size_t i = 0; i < count; ++i)
+			{
+				const double* center = &centers[pick(generator) * dim];
+				for (unsigned int j = 0; j < dim; ++j)
+				{
+					data[i * dim + j] = static_cast<T>(center[j] + spread(generator));
+				}
+			}
+			return true;
+		}
+		std::cout << "unknown distribution " << distribution << std::endl;
+		return false;
+	}
+
+	/******************************************************************************/
+	/*!
+
+	Records the shape of a tree, which tells whether it degenerated.
+
+	*/
+	/******************************************************************************/
+	template <typename Stats, typename Record>
+	void recordShape(const std::string& benchmark, const Stats& shape, Record& record)
+	{
+		record(benchmark, "height", shape.height, "levels");
+		record(benchmark, "average_depth", shape.averageDepth, "levels");
+		record(benchmark, "worst_balance", shape.worstBalance, "share");
+		record(benchmark, "memory", static_cast<double>(shape.memoryBytes), "bytes");
+	}
+
+	/******************************************************************************/
+	/*!
+
+	Runs every benchmark for one distribution and dimension and appends the
+	measurements to "results".
+
+	*/
+	/******************************************************************************/
+	template <typename T, typename Metric>
+	bool run(const Options& options, const std::string& distribution, unsigned int dim, const Metric& metric, std::vector<Result>& results)
+	{
+		typedef KDTree<T, 0, Metric> Tree;
+		std::vector<T> points;
+		std::vector<T> queries;
+		if (!generate(distribution, options.points, dim, options.seed, points) || !generate(distribution, options.queries, dim, options.seed + 1, queries))
+		{
+			return false;
+		}
+		auto record = [&results, &distribution, dim](const std::string& benchmark, const std::string& metric, double value, const std::string& unit)
+		{
+			Result result = { distribution, dim, benchmark, metric, value, unit };
+			results.push_back(result);
+		};
+
+		// bulk build
+		std::vector<double> times;
+		Tree tree(dim, options.bucket, metric);
+		tree.setSplitRule(options.split);
+		for (unsigned int i = 0; i < options.repeat; ++i)
+		{
+			tree.reset();
+			Clock::time_point start = Clock::now();
+			tree.build(points.data(), options.points);
+			times.push_back(elapsedMs(start));
+		}
+		record("build", "time", median(times), "ms");
+		recordShape("build", tree.stats(), record);
+		if (options.relayout)
+		{
+			Clock::time_point start = Clock::now();
+			tree.relayout(options.layout);
+			record("relayout", "time", elapsedMs(start), "ms");
+		}
+
+		// insertion of the points one by one, in the order of the data set
+		times.clear();
+		typename Tree::TreeStats insertedShape;
+		for (unsigned int i = 0; i < options.repeat; ++i)
+		{
+			Tree inserted(dim, options.bucket, metric);
+			inserted.setSplitRule(options.split);
+			typename Tree::Point point(dim);
+			Clock::time_point start = Clock::now();
+			for (size_t j = 0; j < options.points; ++j)
+			{
+				std::copy(points.begin() + j * dim, points.begin() + (j + 1) * dim, point.begin());
+				inserted.insertNewNode(point);
+			}
+			times.push_back(elapsedMs(start));
+			insertedShape = inserted.stats();
+		}
+		record("insert", "time", median(times), "ms");
+		recordShape("insert", insertedShape, record);
+
+		// queries searching a low precision copy, the share of the true neighbors they find is recorded
+		if (options.precision != PRECISION_FULL)
+		{
+			Tree exactTree(tree);
+			tree.setPrecision(options.precision, options.candidates);
+			size_t found = 0;
+			for (size_t i = 0; i < options.queries; ++i)
+			{
+				std::vector<typename Tree::Neighbor> expected = exactTree.knn(&queries[i * dim], options.k);
+				std::vector<typename Tree::Neighbor> closest = tree.knn(&queries[i * dim], options.k);
+				for (size_t j = 0; j < closest.size() && !expected.empty(); ++j)
+				{
+					found += closest[j].distance <= expected.back().distance ? 1 : 0;
+				}
+			}
+			record("query", "recall", static_cast<double>(found) / static_cast<double>(options.queries * options.k), "share");
+			record("query", "memory", static_cast<double>(tree.stats().memoryBytes), "bytes");
+		}
+
+		// latency of single queries
+		std::vector<double> latencies(options.queries);
+		double checksum = 0;
+		for (size_t i = 0; i < options.queries; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			std::vector<typename Tree::Neighbor> closest = tree.knn(&queries[i * dim], options.k);
+			latencies[i] = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+			checksum += closest.empty() ? 0 : static_cast<double>(closest[0].distance);
+		}
+		std::sort(latencies.begin(), latencies.end());
+		double total = 0;
+		for (size_t i = 0; i < latencies.size(); ++i)
+		{
+			total += latencies[i];
+		}
+		record("query", "mean", total / static_cast<double>(latencies.size()), "us");
+		record("query", "p50", percentile(latencies, 0.50), "us");
+		record("query", "p90", percentile(latencies, 0.90), "us");
+		record("query", "p99", percentile(latencies, 0.99), "us");
+		record("query", "p999", percentile(latencies, 0.999), "us");
+		record("query", "max", latencies.back(), "us");
+#ifdef KDTREE_ENABLE_STATS
+		// average work per query, only counted when the tree is built with its counters
+		typename Tree::QueryStats work = typename Tree::QueryStats();
+		typename Tree::SearchLimits exactLimits = { 0.0, 0 };
+		std::vector<typename Tree::Neighbor> closest;
+		for (size_t i = 0; i < options.queries; ++i)
+		{
+			typename Tree::QueryStats query;
+			tree.approximateKnn(&queries[i * dim], options.k, exactLimits, closest, &query);
+			work.nodesVisited += query.nodesVisited;
+			work.distanceEvaluations += query.distanceEvaluations;
+			work.subtreesPruned += query.subtreesPruned;
+			work.maxDepth = std::max(work.maxDepth, query.maxDepth);
+		}
+		const double queryCount = static_cast<double>(std::max<size_t>(options.queries, 1));
+		record("query", "nodes_visited", static_cast<double>(work.nodesVisited) / queryCount, "nodes");
+		record("query", "distance_evaluations", static_cast<double>(work.distanceEvaluations) / queryCount, "distances");
+		record("query", "subtrees_pruned", static_cast<double>(work.subtreesPruned) / queryCount, "subtrees");
+		record("query", "max_depth", work.maxDepth, "levels");
+#endif
+
+		// throughput of batches on the thread pool
+		ThreadPool pool(options.threads);
+		std::vector<typename Tree::Neighbor> batch(options.queries * options.k);
+		times.clear();
+		for (unsigned int i = 0; i < options.repeat; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			tree.knnBatch(queries.data(), options.queries, options.k, batch.data(), pool);
+			times.push_back(elapsedMs(start));
+		}
+		record("batch", "throughput", static_cast<double>(options.queries) / median(times) * 1000.0, "queries/s");
+		record("batch", "threads", pool.size(), "threads");
+		checksum += batch.empty() ? 0 : static_cast<double>(batch[0].distance);
+
+		// the same batch searched with a dual tree, temporary query tree included, and the self join of the points
+		times.clear();
+		for (unsigned int i = 0; i < options.repeat; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			tree.dualTreeKnnBatch(queries.data(), options.queries, options.k, batch.data(), pool);
+			times.push_back(elapsedMs(start));
+		}
+		record("dual_tree_batch", "throughput", static_cast<double>(options.queries) / median(times) * 1000.0, "queries/s");
+		checksum += batch.empty() ? 0 : static_cast<double>(batch[0].distance);
+		std::vector<const T*> selfPoints;
+		std::vector<typename Tree::Neighbor> selfNeighbors;
+		times.clear();
+		for (unsigned int i = 0; i < options.repeat; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			tree.allNearestNeighbors(options.k, selfPoints, selfNeighbors, pool);
+			times.push_back(elapsedMs(start));
+		}
+		record("all_nearest_neighbors", "throughput", static_cast<double>(selfPoints.size()) / median(times) * 1000.0, "points/s");
+
+		// the points split into a forest of shards, built, queried and saved on the thread pool
+		if (options.shards != 0)
+		{
+			typedef ShardedKDTree<T, 0, Metric> Forest;
+			Forest forest(dim, options.bucket, metric);
+			forest.setSplitRule(options.split);
+			times.clear();
+			for (unsigned int i = 0; i < options.repeat; ++i)
+			{
+				Clock::time_point start = Clock::now();
+				if (!forest.build(points.data(), options.points, options.shards, pool))
+					return false;
+				times.push_back(elapsedMs(start));
+			}
+			record("sharded_build", "time", median(times), "ms");
+			record("sharded_build", "shards", forest.shardCount(), "shards");
+			times.clear();
+			for (unsigned int i = 0; i < options.repeat; ++i)
+			{
+				Clock::time_point start = Clock::now();
+				forest.knnBatch(queries.data(), options.queries, options.k, batch.data(), pool);
+				times.push_back(elapsedMs(start));
+			}
+			record("sharded_batch", "throughput", static_cast<double>(options.queries) / median(times) * 1000.0, "queries/s");
+			checksum += batch.empty() ? 0 : static_cast<double>(batch[0].distance);
+			const std::string forestName = "benchmark_forest.kdf";
+			std::vector<double> loadTimes;
+			times.clear();
+			for (unsigned int i = 0; i < options.repeat; ++i)
+			{
+				Clock::time_point start = Clock::now();
+				if (!forest.serialize(forestName, options.directory, options.threads))
+					return false;
+				times.push_back(elapsedMs(start));
+				Forest loaded(dim, options.bucket, metric);
+				start = Clock::now();
+				if (!loaded.deSerialize(forestName, options.directory))
+					return false;
+				loadTimes.push_back(elapsedMs(start));
+				// the reloaded boxes must hold the points on their own boundaries
+				for (unsigned int index = 0; index < forest.shardCount(); ++index)
+				{
+					if (!std::equal(forest.shardLow(index), forest.shardLow(index) + dim, loaded.shardLow(index))
+						|| !std::equal(forest.shardHigh(index), forest.shardHigh(index) + dim, loaded.shardHigh(index)))
+					{
+						std::cout << "shard " << index << " bounds changed on reload" << std::endl;
+						return false;
+					}
+				}
+			}
+			record("serialize_sharded", "time", median(times), "ms");
+			record("deserialize_sharded", "time", median(loadTimes), "ms");
+			std::remove((options.directory + forestName).c_str());
+			for (unsigned int i = 0; i < forest.shardCount(); ++i)
+			{
+				std::remove((options.directory + forestName + "." + std::to_string(i)).c_str());
+			}
+		}
+
+		// serialization in both formats
+		const std::string binaryName = options.directory + "benchmark_tree.kdt";
+		const std::string textName = options.directory + "benchmark_tree";
+		std::vector<double> saveTimes;
+		std::vector<double> loadTimes;
+		for (unsigned int i = 0; i < options.repeat; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			if (!tree.serializeBinary(binaryName))
+				return false;
+			saveTimes.push_back(elapsedMs(start));
+			Tree loaded(dim, options.bucket, metric);
+			start = Clock::now();
+			if (!loaded.deSerialize(binaryName))
+				return false;
+			loadTimes.push_back(elapsedMs(start));
+		}
+		record("serialize_binary", "time", median(saveTimes), "ms");
+		record("deserialize_binary", "time", median(loadTimes), "ms");
+		saveTimes.clear();
+		loadTimes.clear();
+		for (unsigned int i = 0; i < options.repeat; ++i)
+		{
+			Clock::time_point start = Clock::now();
+			if (!tree.serialize(textName, ".csv"))
+				return false;
+			saveTimes.push_back(elapsedMs(start));
+			Tree loaded(dim, options.bucket, metric);
+			start = Clock::now();
+			if (!loaded.deSerialize(textName + ".csv"))
+				return false;
+			loadTimes.push_back(elapsedMs(start));
+		}
+		record("serialize_text", "time", median(saveTimes), "ms");
+		record("deserialize_text", "time", median(loadTimes), "ms");
+		std::remove(binaryName.c_str());
+		std::remove((textName + ".csv").c_str());
+		// keeps the compiler from dropping the queries
+		record("query", "checksum", checksum, "");
+		return true;
+	}
+
+	/******************************************************************************/
+	/*!
+
+	Runs the benchmarks with the metric chosen on the command line. The weighted
+	metric weighs axis i by i + 1.
+
+	*/
+	/******************************************************************************/
+	template <typename T>
+	bool runMetric(const Options& options, const std::string& distribution, unsigned int dim, std::vector<Result>& results)
+	{
+		if (options.metric == "squared_l2")
+			return run<T>(options, distribution, dim, SquaredL2Metric<T>(), results);
+		if (options.metric == "l1")
+			return run<T>(options, distribution, dim, L1Metric<T>(), results);
+		if (options.metric == "linf")
+			return run<T>(options, distribution, dim, LInfMetric<T>(), results);
+		if (options.metric == "weighted_l2")
+		{
+			std::vector<T> weights(dim);
+			for (unsigned int i = 0; i < dim; ++i)
+			{
+				weights[i] = static_cast<T>(i + 1);
+			}
+			return run<T>(options, distribution, dim, WeightedL2Metric<T>(weights), results);
+		}
+		return run<T>(options, distribution, dim, L2Metric<T>(), results);
+	}
+
+	/******************************************************************************/
+	/*!
+
+	Writes the results as one JSON object holding the settings of the run and
+	the list of measurements, or as CSV with one measurement per line.
+
+	*/
+	/******************************************************************************/
+	void report(const Options& options, const std::vector<Result>& results, std::ostream& out)
+	{
+		out.precision(10);
+		if (options.format == "csv")
+		{
+			out << "distribution,dimension,points,queries,k,bucket,type,distance,benchmark,metric,value,unit\n";
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const Result& result = results[i];
+				out << result.distribution << ',' << result.dimension << ',' << options.points << ',' << options.queries << ','
+					<< options.k << ',' << options.bucket << ',' << options.type << ',' << options.metric << ',' << result.benchmark << ','
+					<< result.metric << ',' << result.value << ',' << result.unit << '\n';
+			}
+			return;
+		}
+		out << "{\n  \"config\": {\"points\": " << options.points << ", \"queries\": " << options.queries << ", \"k\": " << options.k
+			<< ", \"bucket\": " << options.bucket << ", \"threads\": " << options.threads << ", \"repeat\": " << options.repeat
+			<< ", \"seed\": " << options.seed << ", \"type\": \"" << options.type << "\", \"distance\": \"" << options.metric << "\", \"split\": \"" << options.splitName << "\", \"layout\": \"" << options.layoutName << "\", \"precision\": \"" << options.precisionName << "\", \"candidates\": " << options.candidates << ", \"shards\": " << options.shards << ", \"kernel\": \"" << DistanceKernel::instructionSet() << "\"},\n";
+		out << "  \"results\": [\n";
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const Result& result = results[i];
+			out << "    {\"distribution\": \"" << result.distribution << "\", \"dimension\": " << result.dimension
+				<< ", \"benchmark\": \"" << result.benchmark << "\", \"metric\": \"" << result.metric
+				<< "\", \"value\": " << result.value << ", \"unit\": \"" << result.unit << "\"}"
+				<< (i + 1 < results.size() ? ",\n" : "\n");
+		}
+		out << "  ]\n}\n";
+	}
+
+	template <typename Number>
+	std::vector<Number> parseList(const std::string& text)
+	{
+		std::vector<Number> values;
+		std::stringstream stream(text);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			if (!item.empty())
+				values.push_back(static_cast<Number>(std::strtoul(item.c_str(), nullptr, 10)));
+		}
+		return values;
+	}
+
+	std::vector<std::string> parseNames(const std::string& text)
+	{
+		std::vector<std::string> names;
+		std::stringstream stream(text);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			if (!item.empty())
+				names.push_back(item);
+		}
+		return names;
+	}
+
+	/******************************************************************************/
+	/*!
+
+	Reads the options from the command line. Returns false on an unknown or
+	incomplete option.
+
+	*/
+	/******************************************************************************/
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		options.points = 100000;
+		options.queries = 10000;
+		options.dimensions = parseList<unsigned int>("2,3,8");
+		options.distributions = parseNames("uniform,clustered,sorted");
+		options.k = 10;
+		options.bucket = 16;
+		options.split = SPLIT_CYCLE;
+		options.splitName = "cycle";
+		options.relayout = false;
+		options.layout = LAYOUT_PREORDER;
+		options.layoutName = "build";
+		options.threads = 0;
+		options.repeat = 3;
+		options.seed = 1;
+		options.type = "double";
+		options.metric = "l2";
+		options.precision = PRECISION_FULL;
+		options.precisionName = "full";
+		options.candidates = 2;
+		options.shards = 8;
+		options.format = "json";
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string name = argv[i];
+			if (i + 1 >= argc)
+			{
+				std::cout << "missing value for " << name << std::endl;
+				return false;
+			}
+			std::string value = argv[++i];
+			if (name == "--points")
+				options.points = std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--queries")
+				options.queries = std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--dims")
+				options.dimensions = parseList<unsigned int>(value);
+			else if (name == "--distributions")
+				options.distributions = parseNames(value);
+			else if (name == "--k")
+				options.k = std::strtoul(value.c_str(), nullptr, 10);
+			else if (name == "--bucket")
+				options.bucket = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			else if (name == "--split")
+				options.splitName = value;
+			else if (name == "--layout")
+				options.layoutName = value;
+			else if (name == "--threads")
+				options.threads = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			else if (name == "--repeat")
+				options.repeat = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			else if (name == "--seed")
+				options.seed = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			else if (name == "--type")
+				options.type = value;
+			else if (name == "--metric")
+				options.metric = value;
+			else if (name == "--precision")
+				options.precisionName = value;
+			else if (name == "--candidates")
+				options.candidates = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			else if (name == "--shards")
+				options.shards = static_cast<unsigned int>(std::strtoul(value.c_str(), nullptr, 10));
+			else if (name == "--format")
+				options.format = value;
+			else if (name == "--output")
+				options.output = value;
+			else if (name == "--dir")
+				options.directory = value.empty() || value[value.size() - 1] == '/' || value[value.size() - 1] == '\\' ? value : value + "/";
+			else
+			{
+				std::cout << "unknown option " << name << std::endl;
+				return false;
+			}
+		}
+		const char* precisions[] = { "full", "float32", "float16", "int16", "int8" };
+		const CoordinatePrecision precisionValues[] = { PRECISION_FULL, PRECISION_FLOAT32, PRECISION_FLOAT16, PRECISION_INT16, PRECISION_INT8 };
+		bool knownPrecision = false;
+		for (size_t i = 0; i < sizeof(precisionValues) / sizeof(precisionValues[0]); ++i)
+		{
+			if (options.precisionName == precisions[i])
+			{
+				options.precision = precisionValues[i];
+				knownPrecision = true;
+			}
+		}
+		const char* splits[] = { "cycle", "variance", "spread", "midpoint" };
+		const SplitRule splitValues[] = { SPLIT_CYCLE, SPLIT_VARIANCE, SPLIT_SPREAD, SPLIT_SLIDING_MIDPOINT };
+		bool knownSplit = false;
+		for (size_t i = 0; i < sizeof(splitValues) / sizeof(splitValues[0]); ++i)
+		{
+			if (options.splitName == splits[i])
+			{
+				options.split = splitValues[i];
+				knownSplit = true;
+			}
+		}
+		const char* layouts[] = { "preorder", "blocked", "veb" };
+		const NodeLayout layoutValues[] = { LAYOUT_PREORDER, LAYOUT_BLOCKED, LAYOUT_VAN_EMDE_BOAS };
+		bool knownLayout = options.layoutName == "build";
+		for (size_t i = 0; i < sizeof(layoutValues) / sizeof(layoutValues[0]); ++i)
+		{
+			if (options.layoutName == layouts[i])
+			{
+				options.layout = layoutValues[i];
+				options.relayout = true;
+				knownLayout = true;
+			}
+		}
+		if (!knownPrecision || !knownSplit || !knownLayout || options.points == 0 || options.queries == 0 || options.repeat == 0 || options.dimensions.empty() || options.distributions.empty()
+			|| std::find(options.dimensions.begin(), options.dimensions.end(), 0u) != options.dimensions.end()
+			|| (options.type != "float" && options.type != "double")
+			|| (options.metric != "l2" && options.metric != "squared_l2" && options.metric != "l1" && options.metric != "linf" && options.metric != "weighted_l2") || (options.format != "json" && options.format != "csv"))
+		{
+			std::cout << "invalid options" << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		return 1;
+	}
+	std::vector<Result> results;
+	for (size_t i = 0; i < options.distributions.size(); ++i)
+	{
+		for (size_t j = 0; j < options.dimensions.size(); ++j)
+		{
+			std::cerr << "running " << options.distributions[i] << " " << options.dimensions[j] << "d" << std::endl;
+			bool done = options.type == "float"
+				? runMetric<float>(options, options.distributions[i], options.dimensions[j], results)
+				: runMetric<double>(options, options.distributions[i], options.dimensions[j], results);
+			if (!done)
+			{
+				return 1;
+			}
+		}
+	}
+	if (options.output.empty())
+	{
+		report(options, results, std::cout);
+		return 0;
+	}
+	std::ofstream file(options.output.c_str());
+	if (!file)
+	{
+		std::cout << "Failed to create file" << " " << options.output << std::endl;
+		return 1;
+	}
+	report(options, results, file);
+	return 0;
+}
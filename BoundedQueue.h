@@ -0,0 +1,130 @@
+/******************************************************************************/
+/*!
+\file   BoundedQueue.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\class BoundedQueue
+\brief
+BoundedQueue passes items from the threads producing them to the threads
+consuming them. It holds at most "capacity" items: a producer finding it full
+waits for a consumer to make room, so a fast stage cannot run ahead of a slow
+one and pile up work in memory.
+
+Once closed, the remaining items can still be taken out but nothing can be put
+in, and consumers waiting on an empty queue are released.
+
+Operations include:
+
+- put an item in, waiting while the queue is full
+- take an item out, waiting while the queue is empty
+- close the queue
+
+*/
+/******************************************************************************/
+
+#pragma once
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+template <typename T>
+class BoundedQueue
+{
+public:
+	BoundedQueue(size_t capacity);
+	bool push(const T& item);
+	bool pop(T& item);
+	void close();
+private:
+	BoundedQueue(const BoundedQueue&);
+	BoundedQueue& operator=(const BoundedQueue&);
+
+	const size_t capacity;
+	std::deque<T> items;
+	std::mutex lock;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+	bool closed;
+};
+
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(size_t maxItems) : capacity(maxItems == 0 ? 1 : maxItems), closed(false)
+{
+}
+
+/******************************************************************************/
+/*!
+
+Puts "item" at the back of the queue, waiting while the queue is full. Returns
+false, dropping the item, if the queue is closed.
+
+*/
+/******************************************************************************/
+template <typename T>
+bool BoundedQueue<T>::push(const T& item)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (!closed && items.size() >= capacity)
+	{
+		notFull.wait(guard);
+	}
+	if (closed)
+		return false;
+	items.push_back(item);
+	guard.unlock();
+	notEmpty.notify_one();
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Takes the item at the front of the queue, waiting while the queue is empty.
+Returns false once the queue is closed and empty.
+
+*/
+/******************************************************************************/
+template <typename T>
+bool BoundedQueue<T>::pop(T& item)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (!closed && items.empty())
+	{
+		notEmpty.wait(guard);
+	}
+	if (items.empty())
+		return false;
+	item = items.front();
+	items.pop_front();
+	guard.unlock();
+	notFull.notify_one();
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Closes the queue and wakes up every waiting thread.
+
+*/
+/******************************************************************************/
+template <typename T>
+void BoundedQueue<T>::close()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		closed = true;
+	}
+	notFull.notify_all();
+	notEmpty.notify_all();
+}
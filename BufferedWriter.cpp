@@ -0,0 +1,145 @@
+/******************************************************************************/
+/*!
+\file   BufferedWriter.cpp
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+#include "BufferedWriter.h"
+#include <cstring>
+#include <iostream>
+
+BufferedWriter::BufferedWriter(size_t bufferSize) : stream(nullptr), buffer(bufferSize == 0 ? 1 : bufferSize), used(0), error(false)
+{
+}
+
+BufferedWriter::~BufferedWriter()
+{
+	close();
+}
+
+/******************************************************************************/
+/*!
+
+Creates the file named "filename", replacing it if it exists. A file already
+opened by this object is closed first. Returns false if the file cannot be
+created.
+
+*/
+/******************************************************************************/
+bool BufferedWriter::open(const std::string& filename)
+{
+	close();
+	name = filename;
+	error = false;
+	stream = std::fopen(filename.c_str(), "wb");
+	if (stream == nullptr)
+	{
+		std::cout << "Failed to create file" << " " << filename << std::endl;
+		error = true;
+		return false;
+	}
+	// the buffer of this object does the job, a second one in the C library would only add a copy
+	std::setvbuf(stream, nullptr, _IONBF, 0);
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Writes what is left in the buffer and closes the file. Returns false if any
+write to the file failed.
+
+*/
+/******************************************************************************/
+bool BufferedWriter::close()
+{
+	if (stream == nullptr)
+		return !error;
+	flush();
+	if (std::fclose(stream) != 0 && !error)
+	{
+		std::cout << "Failed to write file" << " " << name << std::endl;
+		error = true;
+	}
+	stream = nullptr;
+	return !error;
+}
+
+/******************************************************************************/
+/*!
+
+Appends "size" bytes to the file. Blocks larger than the buffer go straight to
+the file. Returns false if the file is not open or a write failed.
+
+*/
+/******************************************************************************/
+bool BufferedWriter::write(const char* data, size_t size)
+{
+	if (stream == nullptr || error)
+		return false;
+	if (used + size > buffer.size())
+	{
+		if (!flush())
+			return false;
+		if (size >= buffer.size())
+		{
+			if (std::fwrite(data, 1, size, stream) != size)
+			{
+				std::cout << "Failed to write file" << " " << name << std::endl;
+				error = true;
+				return false;
+			}
+			return true;
+		}
+	}
+	std::memcpy(buffer.data() + used, data, size);
+	used += size;
+	return true;
+}
+
+bool BufferedWriter::write(const std::string& data)
+{
+	return write(data.data(), data.size());
+}
+
+bool BufferedWriter::put(char c)
+{
+	return write(&c, 1);
+}
+
+/******************************************************************************/
+/*!
+
+Hands the content of the buffer to the operating system.
+
+*/
+/******************************************************************************/
+bool BufferedWriter::flush()
+{
+	if (stream == nullptr || error)
+		return false;
+	if (used != 0 && std::fwrite(buffer.data(), 1, used, stream) != used)
+	{
+		std::cout << "Failed to write file" << " " << name << std::endl;
+		error = true;
+	}
+	used = 0;
+	return !error;
+}
+
+/******************************************************************************/
+/*!
+
+Tells whether the file could not be created or a write failed.
+
+*/
+/******************************************************************************/
+bool BufferedWriter::failed() const
+{
+	return error;
+}
@@ -0,0 +1,58 @@
+/******************************************************************************/
+/*!
+\file   BufferedWriter.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\class BufferedWriter
+\brief
+BufferedWriter writes a file through a fixed size buffer. Small writes are
+gathered in the buffer and handed to the operating system in large blocks, so
+writing a file of any size takes the same small amount of memory. Following
+RAII the destructor flushes the buffer and closes the file.
+
+Operations include:
+
+- create a file given the file name
+- append bytes, strings or single characters to it
+- flush and close the file
+
+*/
+/******************************************************************************/
+
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class BufferedWriter
+{
+public:
+	BufferedWriter(size_t bufferSize = 1 << 20);
+	~BufferedWriter();
+	bool open(const std::string& filename);
+	bool close();
+	bool write(const char* data, size_t size);
+	bool write(const std::string& data);
+	bool put(char c);
+	bool flush();
+	bool failed() const;
+private:
+	BufferedWriter(const BufferedWriter&);
+	BufferedWriter& operator=(const BufferedWriter&);
+
+	std::string name;
+	std::FILE* stream;
+	std::vector<char> buffer;
+	//! bytes of the buffer waiting to be written.
+	size_t used;
+	bool error;
+};
@@ -0,0 +1,401 @@
+/******************************************************************************/
+/*!
+\file   CSVReader.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\class CSVReader
+\brief
+CSVReader reads points written one per line as comma separated values. The
+numbers are parsed in place from the file buffer and stored row by row in a
+contiguous buffer, no line or field is copied into a string. Every line must
+hold exactly "dimension" values, blank lines are skipped.
+
+A file can be read in one go, in which case it is mapped and cut into byte
+ranges that are parsed on several threads, or streamed in chunks of points
+through a fixed size buffer, which keeps the memory use bounded.
+
+Operations include:
+
+- read a whole file, optionally on several threads
+- open a file and read it chunk by chunk
+- parse a single line into a point
+
+*/
+/******************************************************************************/
+
+#pragma once
+#include "utilities.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+template <typename T>
+class CSVReader
+{
+public:
+	//! what a line of the file holds.
+	enum LineStatus
+	{
+		BLANK,
+		POINT,
+		INVALID
+	};
+
+	CSVReader(unsigned int dim);
+	~CSVReader();
+	bool readFile(const std::string& filename, std::vector<T>& points, unsigned int threadCount = 0);
+	bool open(const std::string& filename);
+	void close();
+	size_t read(std::vector<T>& points, size_t maxPoints);
+	bool done() const;
+	bool failed() const;
+	LineStatus parseLine(const char* first, const char* last, T* point) const;
+private:
+	//! result of parsing a part of a file.
+	struct RangeResult
+	{
+		std::vector<T> points;
+		size_t lineCount;
+		//! line of the range, counted from 1, holding the first error. 0 when there is none.
+		size_t errorLine;
+	};
+
+	CSVReader(const CSVReader&);
+	CSVReader& operator=(const CSVReader&);
+	void parseRange(const char* first, const char* last, RangeResult& result) const;
+	bool fillBuffer();
+	void reportError(size_t line) const;
+
+	const unsigned int dimension;
+	//! below this many bytes per range a file is not worth splitting.
+	static const size_t minimumRangeSize = 1 << 20;
+	//! size of the buffer used to stream a file.
+	static const size_t streamBufferSize = 1 << 20;
+
+	std::string name;
+	std::FILE* stream;
+	std::vector<char> buffer;
+	//! unread bytes of the buffer are [bufferBegin, bufferEnd).
+	size_t bufferBegin;
+	size_t bufferEnd;
+	bool endOfFile;
+	bool error;
+	size_t lineNumber;
+};
+
+
+template <typename T>
+CSVReader<T>::CSVReader(unsigned int dim) : dimension(dim), stream(nullptr), bufferBegin(0), bufferEnd(0), endOfFile(true), error(false), lineNumber(0)
+{
+}
+
+template <typename T>
+CSVReader<T>::~CSVReader()
+{
+	close();
+}
+
+/******************************************************************************/
+/*!
+
+Parses one line, without its end of line, into "point" which must have room
+for "dimension" values. Returns BLANK for an empty line, INVALID if a value
+cannot be parsed or if the line does not hold exactly "dimension" values.
+
+*/
+/******************************************************************************/
+template <typename T>
+typename CSVReader<T>::LineStatus CSVReader<T>::parseLine(const char* first, const char* last, T* point) const
+{
+	const char* cursor = first;
+	while (cursor != last && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+		++cursor;
+	if (cursor == last)
+		return BLANK;
+	for (unsigned int i = 0; i < dimension; ++i)
+	{
+		cursor = utilities<T>::parseValue(cursor, last, point[i]);
+		if (cursor == nullptr)
+			return INVALID;
+		if (i + 1 < dimension)
+		{
+			if (cursor == last || *cursor != ',')
+				return INVALID;
+			++cursor;
+		}
+	}
+	return cursor == last ? POINT : INVALID;
+}
+
+/******************************************************************************/
+/*!
+
+Parses every line of [first, last) and appends the points to the result. The
+parse stops at the first invalid line.
+
+*/
+/******************************************************************************/
+template <typename T>
+void CSVReader<T>::parseRange(const char* first, const char* last, RangeResult& result) const
+{
+	result.lineCount = 0;
+	result.errorLine = 0;
+	while (first != last)
+	{
+		const char* endOfLine = static_cast<const char*>(std::memchr(first, '\n', static_cast<size_t>(last - first)));
+		if (endOfLine == nullptr)
+			endOfLine = last;
+		++result.lineCount;
+		size_t size = result.points.size();
+		result.points.resize(size + dimension);
+		LineStatus status = parseLine(first, endOfLine, &result.points[size]);
+		if (status != POINT)
+		{
+			result.points.resize(size);
+			if (status == INVALID)
+			{
+				result.errorLine = result.lineCount;
+				return;
+			}
+		}
+		first = endOfLine == last ? last : endOfLine + 1;
+	}
+}
+
+template <typename T>
+void CSVReader<T>::reportError(size_t line) const
+{
+	std::cout << "invalid line " << line << " in file " << name << ", expected " << dimension << " comma separated values" << std::endl;
+}
+
+/******************************************************************************/
+/*!
+
+Reads every point of the file and appends them to "points". The file is mapped
+and, when it is large enough, cut at line boundaries into ranges parsed on
+"threadCount" threads, all the hardware threads if it is 0. The points keep the
+order of the file. Returns false, leaving "points" unchanged, if the file cannot
+be opened or holds an invalid line.
+
+*/
+/******************************************************************************/
+template <typename T>
+bool CSVReader<T>::readFile(const std::string& filename, std::vector<T>& points, unsigned int threadCount)
+{
+	name = filename;
+	MappedFile file;
+	if (!file.open(filename))
+	{
+		return false;
+	}
+	const char* data = file.data();
+	const size_t size = file.size();
+	size_t rangeCount = size / minimumRangeSize + 1;
+	ThreadPool pool(rangeCount > 1 ? threadCount : 1);
+	// a few ranges per thread so that the threads can balance uneven lines
+	rangeCount = std::min<size_t>(rangeCount, static_cast<size_t>(pool.size()) * 4);
+	std::vector<size_t> boundaries(1, 0);
+	for (size_t i = 1; i < rangeCount; ++i)
+	{
+		size_t position = std::max(size * i / rangeCount, boundaries.back());
+		const char* endOfLine = static_cast<const char*>(std::memchr(data + position, '\n', size - position));
+		position = endOfLine == nullptr ? size : static_cast<size_t>(endOfLine - data) + 1;
+		boundaries.push_back(position);
+	}
+	boundaries.push_back(size);
+	std::vector<RangeResult> results(boundaries.size() - 1);
+	pool.parallelFor(results.size(), 1, [this, data, &boundaries, &results](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			parseRange(data + boundaries[i], data + boundaries[i + 1], results[i]);
+		}
+	});
+	size_t pointValues = 0;
+	size_t lineOffset = 0;
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		if (results[i].errorLine != 0)
+		{
+			reportError(lineOffset + results[i].errorLine);
+			return false;
+		}
+		lineOffset += results[i].lineCount;
+		pointValues += results[i].points.size();
+	}
+	points.reserve(points.size() + pointValues);
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		points.insert(points.end(), results[i].points.begin(), results[i].points.end());
+		std::vector<T>().swap(results[i].points);
+	}
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Opens a file to be read chunk by chunk with "read".
+
+*/
+/******************************************************************************/
+template <typename T>
+bool CSVReader<T>::open(const std::string& filename)
+{
+	close();
+	name = filename;
+	stream = std::fopen(filename.c_str(), "rb");
+	if (stream == nullptr)
+	{
+		std::cout << "Failed to open file" << " " << filename << std::endl;
+		error = true;
+		return false;
+	}
+	buffer.resize(streamBufferSize);
+	endOfFile = false;
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Closes the file opened by "open".
+
+*/
+/******************************************************************************/
+template <typename T>
+void CSVReader<T>::close()
+{
+	if (stream != nullptr)
+	{
+		std::fclose(stream);
+		stream = nullptr;
+	}
+	bufferBegin = 0;
+	bufferEnd = 0;
+	endOfFile = true;
+	error = false;
+	lineNumber = 0;
+}
+
+/******************************************************************************/
+/*!
+
+Moves the unread bytes to the front of the buffer and reads more of the file
+after them. The buffer grows if a single line does not fit in it. Returns false
+when nothing could be added.
+
+*/
+/******************************************************************************/
+template <typename T>
+bool CSVReader<T>::fillBuffer()
+{
+	if (endOfFile)
+		return false;
+	std::memmove(buffer.data(), buffer.data() + bufferBegin, bufferEnd - bufferBegin);
+	bufferEnd -= bufferBegin;
+	bufferBegin = 0;
+	if (bufferEnd == buffer.size())
+	{
+		buffer.resize(buffer.size() * 2);
+	}
+	size_t count = std::fread(buffer.data() + bufferEnd, 1, buffer.size() - bufferEnd, stream);
+	bufferEnd += count;
+	if (count == 0)
+	{
+		endOfFile = true;
+		if (std::ferror(stream))
+		{
+			std::cout << "Failed to read file" << " " << name << std::endl;
+			error = true;
+		}
+		return false;
+	}
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Appends up to "maxPoints" points of the opened file to "points" and returns how
+many were appended. Returns 0 once the whole file is read or after an error,
+which "failed" tells apart.
+
+*/
+/******************************************************************************/
+template <typename T>
+size_t CSVReader<T>::read(std::vector<T>& points, size_t maxPoints)
+{
+	size_t count = 0;
+	while (count < maxPoints && !error)
+	{
+		const char* first = buffer.data() + bufferBegin;
+		const char* last = buffer.data() + bufferEnd;
+		const char* endOfLine = static_cast<const char*>(std::memchr(first, '\n', static_cast<size_t>(last - first)));
+		if (endOfLine == nullptr)
+		{
+			if (fillBuffer())
+				continue;
+			if (error || first == last)
+				break;
+			// the last line of the file has no end of line
+			endOfLine = last;
+		}
+		++lineNumber;
+		size_t size = points.size();
+		points.resize(size + dimension);
+		LineStatus status = parseLine(first, endOfLine, &points[size]);
+		bufferBegin = endOfLine == last ? bufferEnd : static_cast<size_t>(endOfLine + 1 - buffer.data());
+		if (status == POINT)
+		{
+			++count;
+			continue;
+		}
+		points.resize(size);
+		if (status == INVALID)
+		{
+			reportError(lineNumber);
+			error = true;
+		}
+	}
+	return count;
+}
+
+/******************************************************************************/
+/*!
+
+Tells whether the opened file has been read entirely or an error stopped it.
+
+*/
+/******************************************************************************/
+template <typename T>
+bool CSVReader<T>::done() const
+{
+	return error || (endOfFile && bufferBegin == bufferEnd);
+}
+
+/******************************************************************************/
+/*!
+
+Tells whether the file could not be opened or read, or holds an invalid line.
+
+*/
+/******************************************************************************/
+template <typename T>
+bool CSVReader<T>::failed() const
+{
+	return error;
+}
@@ -0,0 +1,353 @@
+/******************************************************************************/
+/*!
+\file   DistanceKernel.cpp
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+#include "DistanceKernel.h"
+#include <atomic>
+
+#if !defined(KDTREE_DISABLE_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define KDTREE_X86_KERNELS
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC accepts every intrinsic without a target attribute
+#define KDTREE_TARGET(isa)
+#else
+#define KDTREE_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace
+{
+	typedef float (*FloatKernel)(const float*, const float*, unsigned int);
+	typedef double (*DoubleKernel)(const double*, const double*, unsigned int);
+
+	enum InstructionSet
+	{
+		SCALAR,
+		SSE,
+		AVX2,
+		AVX512
+	};
+
+	const char* const instructionSetNames[] = { "scalar", "sse", "avx2", "avx512" };
+
+	float scalarFloat(const float* p1, const float* p2, unsigned int size)
+	{
+		return DistanceKernel::scalar(p1, p2, size);
+	}
+
+	double scalarDouble(const double* p1, const double* p2, unsigned int size)
+	{
+		return DistanceKernel::scalar(p1, p2, size);
+	}
+
+#ifdef KDTREE_X86_KERNELS
+
+	//! adds the lanes of a register pairwise, used to finish the wide versions
+	template <typename T>
+	T sumLanes(T* lanes, unsigned int count)
+	{
+		for (unsigned int width = count / 2; width > 0; width /= 2)
+		{
+			for (unsigned int i = 0; i < width; ++i)
+			{
+				lanes[i] += lanes[i + width];
+			}
+		}
+		return lanes[0];
+	}
+
+	KDTREE_TARGET("sse2")
+	float sseFloat(const float* p1, const float* p2, unsigned int size)
+	{
+		__m128 sum = _mm_setzero_ps();
+		unsigned int i = 0;
+		for (; i + 4 <= size; i += 4)
+		{
+			__m128 diff = _mm_sub_ps(_mm_loadu_ps(p1 + i), _mm_loadu_ps(p2 + i));
+			sum = _mm_add_ps(sum, _mm_mul_ps(diff, diff));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, sum);
+		float distance = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		for (; i < size; ++i)
+		{
+			float diff = p1[i] - p2[i];
+			distance += diff * diff;
+		}
+		return distance;
+	}
+
+	KDTREE_TARGET("sse2")
+	double sseDouble(const double* p1, const double* p2, unsigned int size)
+	{
+		__m128d sum = _mm_setzero_pd();
+		unsigned int i = 0;
+		for (; i + 2 <= size; i += 2)
+		{
+			__m128d diff = _mm_sub_pd(_mm_loadu_pd(p1 + i), _mm_loadu_pd(p2 + i));
+			sum = _mm_add_pd(sum, _mm_mul_pd(diff, diff));
+		}
+		double lanes[2];
+		_mm_storeu_pd(lanes, sum);
+		double distance = lanes[0] + lanes[1];
+		for (; i < size; ++i)
+		{
+			double diff = p1[i] - p2[i];
+			distance += diff * diff;
+		}
+		return distance;
+	}
+
+	KDTREE_TARGET("avx2,fma")
+	float avx2Float(const float* p1, const float* p2, unsigned int size)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		unsigned int i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			__m256 diff = _mm256_sub_ps(_mm256_loadu_ps(p1 + i), _mm256_loadu_ps(p2 + i));
+			sum = _mm256_fmadd_ps(diff, diff, sum);
+		}
+		__m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+		half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+		half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+		float distance = _mm_cvtss_f32(half);
+		for (; i < size; ++i)
+		{
+			float diff = p1[i] - p2[i];
+			distance += diff * diff;
+		}
+		return distance;
+	}
+
+	KDTREE_TARGET("avx2,fma")
+	double avx2Double(const double* p1, const double* p2, unsigned int size)
+	{
+		__m256d sum = _mm256_setzero_pd();
+		unsigned int i = 0;
+		for (; i + 4 <= size; i += 4)
+		{
+			__m256d diff = _mm256_sub_pd(_mm256_loadu_pd(p1 + i), _mm256_loadu_pd(p2 + i));
+			sum = _mm256_fmadd_pd(diff, diff, sum);
+		}
+		__m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+		half = _mm_add_sd(half, _mm_unpackhi_pd(half, half));
+		double distance = _mm_cvtsd_f64(half);
+		for (; i < size; ++i)
+		{
+			double diff = p1[i] - p2[i];
+			distance += diff * diff;
+		}
+		return distance;
+	}
+
+	KDTREE_TARGET("avx512f")
+	float avx512Float(const float* p1, const float* p2, unsigned int size)
+	{
+		__m512 sum = _mm512_setzero_ps();
+		unsigned int i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			__m512 diff = _mm512_sub_ps(_mm512_loadu_ps(p1 + i), _mm512_loadu_ps(p2 + i));
+			sum = _mm512_fmadd_ps(diff, diff, sum);
+		}
+		if (i < size)
+		{
+			// the remaining coordinates are loaded with a mask, the other lanes read as zero
+			__mmask16 mask = static_cast<__mmask16>((1u << (size - i)) - 1);
+			__m512 diff = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, p1 + i), _mm512_maskz_loadu_ps(mask, p2 + i));
+			sum = _mm512_fmadd_ps(diff, diff, sum);
+		}
+		float lanes[16];
+		_mm512_storeu_ps(lanes, sum);
+		return sumLanes(lanes, 16);
+	}
+
+	KDTREE_TARGET("avx512f")
+	double avx512Double(const double* p1, const double* p2, unsigned int size)
+	{
+		__m512d sum = _mm512_setzero_pd();
+		unsigned int i = 0;
+		for (; i + 8 <= size; i += 8)
+		{
+			__m512d diff = _mm512_sub_pd(_mm512_loadu_pd(p1 + i), _mm512_loadu_pd(p2 + i));
+			sum = _mm512_fmadd_pd(diff, diff, sum);
+		}
+		if (i < size)
+		{
+			__mmask8 mask = static_cast<__mmask8>((1u << (size - i)) - 1);
+			__m512d diff = _mm512_sub_pd(_mm512_maskz_loadu_pd(mask, p1 + i), _mm512_maskz_loadu_pd(mask, p2 + i));
+			sum = _mm512_fmadd_pd(diff, diff, sum);
+		}
+		double lanes[8];
+		_mm512_storeu_pd(lanes, sum);
+		return sumLanes(lanes, 8);
+	}
+
+#endif
+
+	/******************************************************************************/
+	/*!
+
+	Asks the processor, and the operating system for the wider registers, which
+	instruction sets can be used.
+
+	*/
+	/******************************************************************************/
+	InstructionSet detectInstructionSet()
+	{
+#if defined(KDTREE_X86_KERNELS) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		bool fma = (info[2] & (1 << 12)) != 0;
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		bool avx2 = false;
+		bool avx512 = false;
+		if (maxLeaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+			avx512 = (info[1] & (1 << 16)) != 0;
+		}
+		if (avx512 && fma && (xcr0 & 0xE6) == 0xE6)
+			return AVX512;
+		if (avx && avx2 && fma && (xcr0 & 0x6) == 0x6)
+			return AVX2;
+		if (sse2)
+			return SSE;
+		return SCALAR;
+#elif defined(KDTREE_X86_KERNELS)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f"))
+			return AVX512;
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return AVX2;
+		if (__builtin_cpu_supports("sse2"))
+			return SSE;
+		return SCALAR;
+#else
+		return SCALAR;
+#endif
+	}
+
+	InstructionSet selectedInstructionSet()
+	{
+		static const InstructionSet instructionSet = detectInstructionSet();
+		return instructionSet;
+	}
+
+	FloatKernel selectFloatKernel()
+	{
+#ifdef KDTREE_X86_KERNELS
+		switch (selectedInstructionSet())
+		{
+		case AVX512:
+			return avx512Float;
+		case AVX2:
+			return avx2Float;
+		case SSE:
+			return sseFloat;
+		default:
+			break;
+		}
+#endif
+		return scalarFloat;
+	}
+
+	DoubleKernel selectDoubleKernel()
+	{
+#ifdef KDTREE_X86_KERNELS
+		switch (selectedInstructionSet())
+		{
+		case AVX512:
+			return avx512Double;
+		case AVX2:
+			return avx2Double;
+		case SSE:
+			return sseDouble;
+		default:
+			break;
+		}
+#endif
+		return scalarDouble;
+	}
+
+	float resolveFloat(const float* p1, const float* p2, unsigned int size);
+	double resolveDouble(const double* p1, const double* p2, unsigned int size);
+
+	//! the kernels start on a resolver which replaces itself by the selected version on the first call.
+	std::atomic<FloatKernel> floatKernel(resolveFloat);
+	std::atomic<DoubleKernel> doubleKernel(resolveDouble);
+
+	float resolveFloat(const float* p1, const float* p2, unsigned int size)
+	{
+		FloatKernel kernel = selectFloatKernel();
+		floatKernel.store(kernel, std::memory_order_relaxed);
+		return kernel(p1, p2, size);
+	}
+
+	double resolveDouble(const double* p1, const double* p2, unsigned int size)
+	{
+		DoubleKernel kernel = selectDoubleKernel();
+		doubleKernel.store(kernel, std::memory_order_relaxed);
+		return kernel(p1, p2, size);
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Squared distance between 2 float points using the selected instruction set.
+
+*/
+/******************************************************************************/
+float DistanceKernel::vectorSquared(const float* p1, const float* p2, unsigned int size)
+{
+	return floatKernel.load(std::memory_order_relaxed)(p1, p2, size);
+}
+
+/******************************************************************************/
+/*!
+
+Squared distance between 2 double points using the selected instruction set.
+
+*/
+/******************************************************************************/
+double DistanceKernel::vectorSquared(const double* p1, const double* p2, unsigned int size)
+{
+	return doubleKernel.load(std::memory_order_relaxed)(p1, p2, size);
+}
+
+/******************************************************************************/
+/*!
+
+Returns the name of the instruction set used for float and double points.
+
+*/
+/******************************************************************************/
+const char* DistanceKernel::instructionSet()
+{
+	return instructionSetNames[selectedInstructionSet()];
+}
+
+DistanceKernel::DistanceKernel()
+{
+}
+
+DistanceKernel::~DistanceKernel()
+{
+}
@@ -0,0 +1,116 @@
+/******************************************************************************/
+/*!
+\file   DistanceKernel.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\class DistanceKernel
+\brief
+DistanceKernel computes squared Eucledian distances between points stored in
+contiguous memory. Nothing is copied or allocated and no square root is taken,
+callers compare squared distances and only take the root of reported results.
+
+float and double have SSE, AVX2 and AVX-512 versions. The best version the
+processor supports is selected the first time it is needed. Other types, short
+points and builds defining KDTREE_DISABLE_SIMD use the scalar loop.
+
+Operations include:
+
+- squared distance between 2 points of any dimension.
+- name of the instruction set selected for float and double.
+
+*/
+/******************************************************************************/
+
+#pragma once
+
+class DistanceKernel
+{
+public:
+	template <typename T>
+	static T squared(const T* p1, const T* p2, unsigned int size);
+	static float squared(const float* p1, const float* p2, unsigned int size);
+	static double squared(const double* p1, const double* p2, unsigned int size);
+	template <typename T>
+	static T scalar(const T* p1, const T* p2, unsigned int size);
+	static const char* instructionSet();
+private:
+	//! below this many coordinates the call to a vector version costs more than it saves.
+	static const unsigned int minimumVectorSize = 8;
+	static float vectorSquared(const float* p1, const float* p2, unsigned int size);
+	static double vectorSquared(const double* p1, const double* p2, unsigned int size);
+	DistanceKernel();
+	~DistanceKernel();
+};
+
+/******************************************************************************/
+/*!
+
+Squared distance for the types without a vector version.
+
+*/
+/******************************************************************************/
+template <typename T>
+inline T DistanceKernel::squared(const T* p1, const T* p2, unsigned int size)
+{
+	return scalar(p1, p2, size);
+}
+
+/******************************************************************************/
+/*!
+
+Squared distance between 2 float points. Short points stay inline.
+
+*/
+/******************************************************************************/
+inline float DistanceKernel::squared(const float* p1, const float* p2, unsigned int size)
+{
+	if (size < minimumVectorSize)
+	{
+		return scalar(p1, p2, size);
+	}
+	return vectorSquared(p1, p2, size);
+}
+
+/******************************************************************************/
+/*!
+
+Squared distance between 2 double points. Short points stay inline.
+
+*/
+/******************************************************************************/
+inline double DistanceKernel::squared(const double* p1, const double* p2, unsigned int size)
+{
+	if (size < minimumVectorSize)
+	{
+		return scalar(p1, p2, size);
+	}
+	return vectorSquared(p1, p2, size);
+}
+
+/******************************************************************************/
+/*!
+
+Plain loop used as fallback by every type.
+
+*/
+/******************************************************************************/
+template <typename T>
+inline T DistanceKernel::scalar(const T* p1, const T* p2, unsigned int size)
+{
+	T distance = 0;
+	for (unsigned int i = 0; i < size; ++i)
+	{
+		T diff = p1[i] - p2[i];
+		distance = distance + diff * diff;
+	}
+	return distance;
+}
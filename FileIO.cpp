@@ -16,24 +16,25 @@
 /*!
 
 Reads the file named "filename". Returns a data in string format using the vector container. It gives an empty container if failed to open the file.
+The file gets a stream of its own, so several threads can read files at once.
 
 */
 /******************************************************************************/
 const std::vector<std::string> FileIO::readFile(const std::string& filename)
 {
 	std::vector<std::string> lines;
-	port.open(filename.c_str(), std::ios::in | std::ios::binary);
-	if (port.fail())
+	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+	if (file.fail())
 	{
 		std::cout << "Failed to open file" << " " << filename << std::endl;
 		return lines;
 	}
 	std::string eachline;
-	while (std::getline(port, eachline))
+	while (std::getline(file, eachline))
 	{
 		lines.push_back(eachline);
 	}
-	port.close();
+	file.close();
 	return lines;
 }
 
@@ -69,6 +70,38 @@ bool FileIO::openFiletoWrite(const std::string& fileName, const std::string& ext
 /******************************************************************************/
 /*!
 
+Creates the file "fileName" and writes the given blocks of bytes one after the
+other. Each block is a pointer to its first byte and its size. Retrun true if
+succeeds and false if failed to create or write the file. The file gets a stream
+of its own, so several threads can write binary files at once.
+
+*/
+/******************************************************************************/
+
+bool FileIO::writeBinaryFile(const std::string& fileName, const std::vector<std::pair<const char*, size_t> >& blocks)
+{
+	std::ofstream file(fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (file.fail())
+	{
+		std::cout << "Failed to create file" << " " << fileName << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < blocks.size() && file.good(); ++i)
+	{
+		file.write(blocks[i].first, static_cast<std::streamsize>(blocks[i].second));
+	}
+	bool written = file.good();
+	file.close();
+	if (!written)
+	{
+		std::cout << "Failed to write file" << " " << fileName << std::endl;
+	}
+	return written;
+}
+
+/******************************************************************************/
+/*!
+
 this return a reference to a static object of class FileIO, thus ensures that only one object is instanced per life cycle.
 
 */
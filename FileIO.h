@@ -22,6 +22,7 @@ Operations include:
 
 - Read a file given the file name
 - write data on to a file given the file name and extension of choice
+- write blocks of raw bytes on to a file
 
 */
 /******************************************************************************/
@@ -30,12 +31,14 @@ Operations include:
 #include <string>  //for std::string operations
 #include <vector>  //a very useful data structures which grows dynamically
 #include <fstream> //for all file related operations
+#include <utility> //std::pair
 
 class FileIO
 {
 public:
 	const std::vector<std::string> readFile(const std::string& filename);
 	bool openFiletoWrite(const std::string& fileName, const std::string& ext, const std::vector<std::string>& data);
+	bool writeBinaryFile(const std::string& fileName, const std::vector<std::pair<const char*, size_t> >& blocks);
 	static FileIO& getInstance();
 private:
 	FileIO();
@@ -16,14 +16,104 @@
 \brief
 KDTree is responsible to construct tree based on the given data set, save the current tree state, read back a tree, find the nearest neighbor etc.
 
+The tree is stored in two flat arrays. "nodes" holds one small record per node
+and "coordinates" holds the points row by row. An inner node only keeps its
+splitting dimension, its splitting value and the 32 bit indices of its two
+children. The points live in the leaves: a leaf holds up to "bucketSize" points
+stored as consecutive rows of "coordinates", which a search scans one after the
+other with the distance kernel. With the default of 16 points per leaf the tree
+has about n / 5 nodes instead of n, and a search makes that many fewer branch
+decisions and jumps through memory.
+
+Each inner node stores the dimension it splits along, so the searches never
+derive it from the depth. The builds choose it with a split rule: the
+dimensions in turn by default, or the dimension along which the points of the
+node have the largest variance or spread, split at the median, or a sliding
+midpoint split. The adaptive rules suit data stretched along some dimensions,
+such as points along a road or features of very different ranges, where
+cutting every dimension in turn wastes levels on the narrow ones.
+
+The dimension is either given at run time, KDTree<T>(dim), or fixed at compile
+time, KDTree<T, Dim>(). A fixed dimension tree takes its points as
+std::array<T, Dim>, each row of "coordinates" has the same layout, and the
+distance and splitting dimension computations are unrolled by the compiler.
+
+The distance is a policy given as third template argument, KDTree<T, Dim,
+L1Metric<T> >, Eucledian by default. Metric.h holds the L2, squared L2, L1,
+L-infinity and weighted L2 metrics. Searches compare the reduced distances of
+the metric, squared distances for the L2 ones computed by DistanceKernel, and
+skip a subtree with the bound the metric gives for the gap to its splitting
+plane. The nearest neighbor searches tighten that bound to the distance to the
+whole cell of the subtree, kept up to date one gap at a time as they cross the
+splits. The distances are only turned back for the results handed to the
+caller.
+
+The tree can also keep a low precision copy of its points, 32 or 16 bit floats
+or 16 or 8 bit integers scaled to the bounds of each axis. The nearest neighbor
+searches then scan the copy, which takes up to 8 times less memory bandwidth,
+gather a few times more candidates than asked for, and rank those again with
+their full precision points. Only the candidates read the full precision
+points, which can stay in a mapped file.
+
+Large batches of queries can be searched with a dual tree search, which builds
+a temporary tree over the queries and walks both trees together. A leaf of
+queries shares one descent of the tree, and its queries only scan the leaves
+that may hold a closer point for them. The same search runs with the tree
+against itself to find the nearest other points of all its points.
+
+Every traversal walks the tree with an explicit stack instead of recursing. A
+search keeps up to 64 pending subtrees in a fixed array on the call stack and
+allocates nothing, and a tree deeper than that, for example read from a text
+file written by another program, spills to the heap instead of overflowing the
+call stack.
+
+The tree can be saved as text, one line per node, or in a binary format holding
+a header and the two arrays as they are in memory. A binary file is mapped by
+"deSerialize" and queried in place: nothing is parsed or allocated and several
+processes loading the same file share its pages. The queries read the arrays
+through "nodeView" and "coordinateView", which point either to the owned
+vectors or to the mapping. Modifying a mapped tree copies it to memory first.
+
+A build allocates the nodes as it goes, depth first, which leaves the right
+children far from their parents, and insertions append new nodes and rows at the
+end. "relayout" reorders both arrays so that the nodes a search visits one after
+the other share cache lines and pages: van Emde Boas order keeps any subtree of
+h levels within about h / log2(B) blocks of B nodes, whatever the block size,
+and the points of the leaves follow each other in the order of the tree, so
+that nearby leaves hold nearby rows. The binary format writes the arrays as
+they are, so a file saved after "relayout" is mapped with the same layout.
+
 Operations include:
 
-- construct a tree from a file.
-- insert a node in the tree.
-- destroy the created tree
-- save the constructed tree.
-- load back the constructed tree.
-- Query closest neighbor
+- construct a balanced tree from a file or from an in-memory list of points.
+  Files are parsed in place, on several threads when they are large.
+- insert a point in the tree, splitting a leaf once it holds too many points.
+- remove or move a point. Subtrees that lose their balance through insertions
+  and removals are rebuilt, so the depth stays logarithmic under churn.
+- choose how many points a leaf holds.
+- choose how the splitting dimension and value of the nodes are chosen
+- destroy the created tree, releasing its arrays or keeping them for the
+  next build
+- reserve room for a number of points so that insertions do not allocate
+- lay the nodes out in van Emde Boas or page blocked order, and the points in
+  the order of the leaves, in memory and in binary files
+- copy a tree, sharing a mapped file.
+- save the constructed tree, as text or binary.
+- load back the constructed tree, mapping binary files in place.
+- Query closest neighbor of every point of a file, streamed in bounded memory
+- Query the k closest neighbors of a point, or only those closer than a
+  given distance
+- Query every point within a radius or inside an axis aligned box
+- Query the k closest neighbors of a batch of points on several threads
+- Query a large batch of points with a dual tree search, or every point of the
+  tree against the others
+- Query approximate neighbors within a distance factor or a leaf budget,
+  knowing whether the result is still exact
+- Search a low precision copy of the points, re-ranking the candidates found
+  with the full precision points
+- Count the work done by each query, in builds defining KDTREE_ENABLE_STATS
+- Report the shape of the tree: height, depth of the leaves, balance of the
+  splits along each axis and memory used
 
 */
 /******************************************************************************/
@@ -31,396 +121,3333 @@ Operations include:
 #pragma once
 #include "utilities.h"
 #include "FileIO.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
+#include "CSVReader.h"
+#include "BoundedQueue.h"
+#include "BufferedWriter.h"
+#include "TraversalStack.h"
+#include "Metric.h"
+#include "LowPrecisionCoordinates.h"
 #include <limits>
 #include <math.h>
 #include <iostream>
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+// the counters of the queries cost a few instructions per node, builds not asking for them leave them out
+#ifdef KDTREE_ENABLE_STATS
+#define KDTREE_STAT(statement) statement
+#else
+#define KDTREE_STAT(statement)
+#endif
+
+//! how the builds choose the splitting dimension and value of a node.
+enum SplitRule
+{
+	//! the dimensions in turn, from the dimension of the parent, split at the median. The default.
+	SPLIT_CYCLE,
+	//! the dimension along which the points of the node have the largest variance, split at the median.
+	SPLIT_VARIANCE,
+	//! the dimension along which the points of the node are the most spread out, split at the median.
+	SPLIT_SPREAD,
+	//! the most spread out dimension, split halfway between its lowest and highest point. The split slides toward the median when halfway leaves too many points on one side.
+	SPLIT_SLIDING_MIDPOINT
+};
+
+//! order of the nodes in the node array, chosen by "relayout". Builds and insertions give a depth first order of pairs of siblings.
+enum NodeLayout
+{
+	//! every node before its subtrees, the left subtree before the right one.
+	LAYOUT_PREORDER,
+	//! subtrees a few levels high filling a page each, their nodes breadth first, the subtrees hanging below a block after it.
+	LAYOUT_BLOCKED,
+	//! van Emde Boas order: the top half of the levels first, then each subtree hanging below it, each laid out the same way.
+	LAYOUT_VAN_EMDE_BOAS
+};
 
-template <typename T>
+template <typename T, unsigned int Dim = 0, typename Metric = L2Metric<T> >
 class KDTree
 {
-	//! this is the structure of the node for KDTree.
+public:
+	//! type of the points given to the tree, std::vector<T> when the dimension is known at run time only.
+	typedef typename std::conditional<Dim == 0, std::vector<T>, std::array<T, Dim> >::type Point;
+
+	typedef Metric MetricType;
+	//! one result of a nearest neighbor query. "point" stays valid until the tree is modified.
+	struct Neighbor
+	{
+		const T* point;
+		T distance;
+	};
+
+	//! limits of an approximate nearest neighbor search.
+	struct SearchLimits
+	{
+		//! a subtree is skipped unless it may hold a point closer than the farthest neighbor found divided by (1 + epsilon), 0 searches exactly.
+		double epsilon;
+		//! the search stops once this many leaves are scanned, 0 for no limit.
+		size_t maxLeaves;
+	};
+
+	//! work done by a search. Only counted in builds defining KDTREE_ENABLE_STATS, left at 0 otherwise.
+	struct QueryStats
+	{
+		size_t nodesVisited;
+		size_t distanceEvaluations;
+		//! subtrees skipped because they could not hold a closer point, or because the leaf budget was spent.
+		size_t subtreesPruned;
+		//! depth of the deepest node visited, the root being at depth 0.
+		unsigned int maxDepth;
+	};
+
+	//! shape of the tree, as reported by "stats".
+	struct TreeStats
+	{
+		size_t pointCount;
+		size_t innerNodeCount;
+		size_t leafCount;
+		//! depth of the deepest leaf, the root being at depth 0.
+		unsigned int height;
+		//! average depth of the points, which is what a query pays to reach them.
+		double averageDepth;
+		//! leafDepths[d] is the number of leaves at depth d.
+		std::vector<size_t> leafDepths;
+		//! axisSplits[a] is the number of inner nodes splitting along axis a.
+		std::vector<size_t> axisSplits;
+		//! axisBalance[a] is the average share of the points of a node held by its larger child, over the nodes splitting along axis a. 0.5 is a perfect split.
+		std::vector<double> axisBalance;
+		//! largest share held by the larger child of any inner node.
+		double worstBalance;
+		//! nodes and rows left unused by rebuilds and removals, until they are reused or compacted.
+		size_t freeNodeCount;
+		size_t garbageRows;
+		//! bytes allocated by the tree, and bytes of the mapped binary file it reads.
+		size_t memoryBytes;
+		size_t mappedBytes;
+	};
+
+private:
+	//! keeps the k closest neighbors found so far in a max-heap, so the farthest of them is always on top.
+	class NeighborHeap
+	{
+	public:
+		NeighborHeap(std::vector<Neighbor>& storage, size_t k, T bound = std::numeric_limits<T>::max());
+		T worstDistance() const;
+		void push(const T* point, T distance);
+		void sort();
+	private:
+		static bool closer(const Neighbor& lhs, const Neighbor& rhs);
+		std::vector<Neighbor>& heap;
+		const size_t capacity;
+		//! a point must be closer than this to enter the heap while it is not full.
+		const T limit;
+	};
+
+	//! state of one nearest neighbor search: the neighbors found so far and what is left of its limits.
+	struct SearchState
+	{
+		SearchState(NeighborHeap& heap, const SearchLimits& limits);
+		bool explore(T cellDistance);
+		NeighborHeap& champions;
+		//! (1 + epsilon) to the power of the metric, the search compares reduced distances.
+		double factor;
+		size_t leavesLeft;
+		//! cleared as soon as a subtree that may hold a closer point is skipped.
+		bool exact;
+#ifdef KDTREE_ENABLE_STATS
+		QueryStats counters;
+#endif
+	};
+
+	//! subtree a search still has to visit: the far side of a split, the reduced distance from the query to its cell, and the
+	//! axis bound its cell has along "axis". An entry whose "node" is invalidNode restores that axis bound once a far side is done.
+	struct PendingNode
+	{
+		unsigned int node;
+		unsigned int depth;
+		unsigned int axis;
+		T axisBound;
+		T cellDistance;
+	};
+
+	//! query node and reference node a dual tree search still has to compare, and the reduced distance between their boxes.
+	struct PendingPair
+	{
+		unsigned int query;
+		unsigned int reference;
+		T distance;
+	};
+
+	//! subtree the build still has to make out of the rows in [first, last).
+	struct PendingBuild
+	{
+		std::vector<unsigned int>::iterator first;
+		std::vector<unsigned int>::iterator last;
+		unsigned int axis;
+		unsigned int node;
+	};
+
+	//! node a traversal still has to visit, and its depth.
+	struct PendingDepth
+	{
+		unsigned int node;
+		unsigned int depth;
+	};
+
+	//! this is the structure of the node for KDTree. An inner node splits along "axis": points whose coordinate is at most
+	//! "split" are on the left and at least "split" on the right, children are indices into "nodes". A leaf has its "axis"
+	//! set to leafAxis and holds "count" points stored from row "begin" of "coordinates". "size" is the number of points of
+	//! the subtree, it tells when a subtree is out of balance.
 	typedef struct Node
 	{
-		Node(const std::vector<T>& newData);
-		~Node();
-		Node * left;
-		Node * right;
-		std::vector<T> data;
+		unsigned int axis;
+		unsigned int size;
+		union
+		{
+			unsigned int left;
+			unsigned int begin;
+		};
+		union
+		{
+			unsigned int right;
+			unsigned int count;
+		};
+		T split;
 	}KDNode;
 
-	//! this saves the root of the tree.
-	KDNode * root;
-	bool constructKDTree(const std::vector<KDNode*>&);
+	//! header of a binary tree file. The node array and the coordinates follow at the given offsets.
+	struct FileHeader
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byteOrder;
+		std::uint32_t typeTag;
+		std::uint32_t dimension;
+		std::uint32_t root;
+		std::uint32_t bucketSize;
+		std::uint64_t nodeCount;
+		//! rows of the coordinates, rows left unused by insertions included.
+		std::uint64_t rowCount;
+		std::uint64_t nodeOffset;
+		std::uint64_t coordinateOffset;
+		//! checksum of the node array and the coordinates.
+		std::uint64_t checksum;
+	};
+
+	//! queries of a file read, searched and written as one block by "kNearestNeighbor".
+	struct QueryChunk
+	{
+		std::vector<T> queries;
+		std::vector<Neighbor> closest;
+		std::vector<std::string> lines;
+		size_t count;
+	};
+
+	//! index used for a missing child or an empty tree.
+	static constexpr unsigned int invalidNode = 0xFFFFFFFF;
+	//! splitting dimension marking a leaf.
+	static constexpr unsigned int leafAxis = 0xFFFFFFFF;
+	//! points held by a leaf unless the user chooses otherwise.
+	static constexpr unsigned int defaultBucketSize = 16;
+	//! a subtree is rebuilt once one of its children holds more than this percentage of its points.
+	static constexpr unsigned int balancePercent = 70;
+	//! largest percentage of the points a sliding midpoint split leaves to a child. It stays below balancePercent, so a new subtree takes many updates to go out of balance.
+	static constexpr unsigned int midpointPercent = 60;
+	//! version of the binary format written by serializeBinary.
+	static constexpr std::uint32_t binaryVersion = 3;
+	//! the arrays of a binary file start on multiples of this many bytes.
+	static constexpr size_t binaryAlignment = 64;
+	//! chunks in flight in "kNearestNeighbor": one read, one searched, one written and one spare.
+	static constexpr size_t queryChunkCount = 4;
+	//! most dimensions a low precision copy can have, a leaf scan decodes one point at a time into a buffer of this size.
+	static constexpr unsigned int maxLowPrecisionDimension = 1024;
+	//! pending subtrees a traversal keeps without allocating. Rebuilds keep the height of a tree of n points within about 2 log2(n).
+	static constexpr size_t stackCapacity = 64;
+	//! dimensions whose gaps to the cell a nearest neighbor search keeps on the call stack, the gaps of more dimensions are allocated.
+	static constexpr unsigned int offsetCapacity = 64;
+	//! work buffers up to this many values are kept between updates, larger ones are released after use.
+	static constexpr size_t scratchLimit = 1 << 16;
+	//! bytes of nodes LAYOUT_BLOCKED puts in one block, a page.
+	static constexpr size_t layoutBlockBytes = 4096;
+
+	//! this saves the index of the root of the tree.
+	unsigned int root;
+	//! all the nodes of the tree.
+	std::vector<KDNode> nodes;
+	//! points of all the leaves, stored row by row. The points of a leaf are contiguous.
+	std::vector<T> coordinates;
 	const unsigned dimension;
-	KDNode * newNode(const std::vector<T>&) const;
-	KDNode * insert(KDNode * currNode, KDNode * newNode, unsigned int level) const;
-	void nearestNeighbor(KDNode* queryPoint, KDNode* currPoint, KDNode& champion, T& closestDistance, unsigned int level) const;
-	void helperSerialize(const KDNode *, std::vector<std::string >&) const;
-	KDNode* reConstructTree(KDNode* curr, const std::vector<std::string>&, unsigned int& index)const;
-	KDNode* getRoot()const;
+	//! distance the searches use. Most metrics hold nothing, a weighted one holds its weights.
+	Metric metric;
+	//! most points a leaf holds before it is split.
+	unsigned int bucketSize;
+	//! how the builds, the leaf splits and the rebuilds choose the splits of the nodes they make.
+	SplitRule splitRule;
+	//! rows of "coordinates" no leaf uses anymore, left behind by leaves moved to grow and by removed points.
+	size_t garbageRows;
+	//! nodes of rebuilt subtrees, reused before the node array grows.
+	std::vector<unsigned int> freeNodes;
+	//! arrays used by the queries, either the two vectors above or a mapped binary file.
+	const KDNode* nodeView;
+	const T* coordinateView;
+	size_t nodeCount;
+	size_t rowCount;
+	//! binary file the views point into, empty when the tree owns its arrays.
+	std::shared_ptr<MappedFile> mapping;
+	//! copy of "coordinates" scanned by the nearest neighbor searches when it is not empty. Modifying the tree drops it.
+	LowPrecisionCoordinates<T> lowPrecision;
+	//! a search of the low precision copy gathers this many times more candidates than the neighbors asked for.
+	unsigned int candidateFactor;
+	//! work buffers of the updates, reused so that splitting a leaf, rebuilding a subtree or removing a point does not allocate.
+	std::vector<T> scratchPoints;
+	std::vector<unsigned int> scratchRows;
+	std::vector<unsigned int> scratchPath;
+
+	KDTree& operator=(const KDTree&);
+
+	bool buildFromSource(std::vector<T>& source);
+	bool constructKDTree(const std::vector<T>& source, std::vector<unsigned int>& rows);
+	void constructKDTree(const std::vector<T>& source, std::vector<unsigned int>::iterator first, std::vector<unsigned int>::iterator last, unsigned int axis, unsigned int currNode, unsigned int& nextRow);
+	std::vector<unsigned int>::iterator splitRows(const std::vector<T>& source, std::vector<unsigned int>::iterator first, std::vector<unsigned int>::iterator last, unsigned int& axis, T& split) const;
+	unsigned int newNode();
+	void insert(unsigned int leaf, const T* newData, unsigned int axis);
+	void splitLeaf(unsigned int leaf, unsigned int axis);
+	bool unbalanced(unsigned int size, unsigned int larger) const;
+	void rebuild(unsigned int currNode, const T* newData);
+	void collect(unsigned int currNode, std::vector<T>& source);
+	bool locate(unsigned int currNode, const T* data, std::vector<unsigned int>& path, unsigned int& row) const;
+	void compact();
+	void releaseScratch();
+	void layoutOrder(NodeLayout layout, std::vector<unsigned int>& order) const;
+	void vanEmdeBoasOrder(unsigned int top, unsigned int levels, std::vector<unsigned int>& order) const;
+	void collectStats(unsigned int currNode, unsigned int depth, TreeStats& stats) const;
+	void nearestNeighbor(const T* queryPoint, unsigned int currPoint, SearchState& search) const;
+	bool boundedKnn(const T* query, size_t k, T bound, const SearchLimits& limits, std::vector<Neighbor>& result, QueryStats* stats) const;
+	void scanLowPrecision(const T* queryPoint, const KDNode& leaf, NeighborHeap& champions) const;
+	void nodeBoxes(std::vector<T>& boxes, std::vector<unsigned int>& parents) const;
+	T boxDistance(const T* first, const T* second, T* closest) const;
+	void dualTreeKnn(const KDTree& queryTree, size_t k, bool self, Neighbor* heaps, unsigned int* heapSizes, ThreadPool& pool) const;
+	void dualTreeSearch(const KDTree& queryTree, unsigned int queryRoot, const T* queryBoxes, const unsigned int* queryParents, const T* referenceBoxes, size_t k, bool self, Neighbor* heaps, unsigned int* heapSizes, T* bounds) const;
+	template <typename Callback>
+	void radiusSearch(const T* queryPoint, T radius, unsigned int currPoint, Callback& callback, size_t& found) const;
+	template <typename Callback>
+	void boxSearch(const T* low, const T* high, unsigned int currPoint, Callback& callback, size_t& found) const;
+	unsigned int dim() const;
+	unsigned int nextAxis(unsigned int axis) const;
+	T reducedDistance(const T* p1, const T* p2) const;
+	void helperSerialize(unsigned int curr, std::vector<std::string >&) const;
+	bool reConstructTree(const std::vector<std::string>&, unsigned int& index, unsigned int currNode);
+	unsigned int getRoot()const;
+	const T* point(unsigned int row) const;
+	const KDNode& node(unsigned int index) const;
+	void updateViews();
+	void ensureOwned();
+	bool metricFits() const;
+	bool loadBinary(const std::shared_ptr<MappedFile>& file, const std::string& filename, bool verifyChecksum);
+	bool validNodes(const KDNode* fileNodes, const FileHeader& header) const;
+	static std::uint32_t typeTag();
+	static std::uint64_t checksum(const char* data, size_t size, std::uint64_t seed);
 
 public:
-	KDTree(unsigned int dim);
+	KDTree();
+	KDTree(unsigned int dim, unsigned int bucket = defaultBucketSize, const Metric& distanceMetric = Metric());
+	KDTree(const KDTree& other);
 	~KDTree();
-	void insertNewNode(const std::vector<T>& newData);
+	void insertNewNode(const Point& newData);
+	bool remove(const Point& data);
+	bool update(const Point& oldData, const Point& newData);
+	void setBucketSize(unsigned int bucket);
+	unsigned int getBucketSize() const;
+	void setSplitRule(SplitRule rule);
+	SplitRule getSplitRule() const;
+	const Metric& getMetric() const;
+	bool setPrecision(CoordinatePrecision precision, unsigned int candidates = 2);
+	CoordinatePrecision getPrecision() const;
+	bool build(const std::vector<Point>& points);
+	bool build(const T* points, size_t pointCount);
 	void clear();
+	void reset();
+	void reserve(size_t pointCount);
+	void relayout(NodeLayout layout);
 	bool serialize(const std::string& filename, const std::string& extension, std::string location = "") const;
-	bool deSerialize(const std::string& filename, const std::string& location = "");
-	bool buildfromFile(const std::string& filename, const std::string& location = "");
-	bool kNearestNeighbor(const std::string& queryFileName, const std::string& destinationFileName = "QueriedList", const std::string& ext = ".csv")const;
+	bool serializeBinary(const std::string& filename, const std::string& location = "") const;
+	bool deSerialize(const std::string& filename, const std::string& location = "", bool verifyChecksum = true);
+	bool buildfromFile(const std::string& filename, const std::string& location = "", unsigned int threadCount = 0);
+	bool kNearestNeighbor(const std::string& queryFileName, const std::string& destinationFileName = "QueriedList", const std::string& ext = ".csv", unsigned int threadCount = 0, size_t chunkSize = 16384)const;
+	std::vector<Neighbor> knn(const T* query, size_t k) const;
+	std::vector<Neighbor> knn(const Point& query, size_t k) const;
+	void knnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, unsigned int threadCount = 0) const;
+	void knnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, ThreadPool& pool) const;
+	std::vector<Neighbor> knn(const T* query, size_t k, T maxDistance) const;
+	bool approximateKnn(const T* query, size_t k, const SearchLimits& limits, std::vector<Neighbor>& result, QueryStats* stats = nullptr) const;
+	size_t approximateKnnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, const SearchLimits& limits, bool* exact, ThreadPool& pool, QueryStats* stats = nullptr) const;
+	void dualTreeKnnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, unsigned int threadCount = 0) const;
+	void dualTreeKnnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, ThreadPool& pool) const;
+	size_t allNearestNeighbors(size_t k, std::vector<const T*>& points, std::vector<Neighbor>& results, unsigned int threadCount = 0) const;
+	size_t allNearestNeighbors(size_t k, std::vector<const T*>& points, std::vector<Neighbor>& results, ThreadPool& pool) const;
+	template <typename Callback>
+	size_t radiusSearch(const T* query, T radius, Callback callback) const;
+	size_t radiusSearch(const T* query, T radius, std::vector<Neighbor>& result) const;
+	template <typename Callback>
+	size_t boxSearch(const T* low, const T* high, Callback callback) const;
+	size_t boxSearch(const T* low, const T* high, std::vector<const T*>& result) const;
+	TreeStats stats() const;
 };
 
 
-template <typename T>
-KDTree<T>::Node::Node(const std::vector<T>& newData) : left(nullptr), right(nullptr), data(newData)
+template <typename T, unsigned int Dim, typename Metric>
+KDTree<T, Dim, Metric>::NeighborHeap::NeighborHeap(std::vector<Neighbor>& storage, size_t k, T bound) : heap(storage), capacity(k), limit(bound)
+{
+	heap.clear();
+	heap.reserve(k);
+}
+
+/******************************************************************************/
+/*!
+
+Returns the distance a point has to beat to enter the heap. Until k neighbors
+are found every point closer than the bound of the heap qualifies.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+T KDTree<T, Dim, Metric>::NeighborHeap::worstDistance() const
 {
+	if (heap.size() < capacity)
+	{
+		return limit;
+	}
+	return heap.front().distance;
 }
 
-template <typename T>
-KDTree<T>::Node::~Node()
+/******************************************************************************/
+/*!
+
+Adds a point to the heap. When the heap is full the farthest neighbor is
+dropped if the new point is closer, otherwise the new point is ignored.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::NeighborHeap::push(const T* point, T distance)
 {
-	if (left != nullptr)
+	if (capacity == 0)
 	{
-		left->data.clear();
-		delete left;
-		left = nullptr;
+		return;
+	}
+	Neighbor neighbor;
+	neighbor.point = point;
+	neighbor.distance = distance;
+	if (heap.size() < capacity)
+	{
+		heap.push_back(neighbor);
+		std::push_heap(heap.begin(), heap.end(), closer);
 	}
-	if (right != nullptr)
+	else if (distance < heap.front().distance)
 	{
-		right->data.clear();
-		delete right;
-		right = nullptr;
+		std::pop_heap(heap.begin(), heap.end(), closer);
+		heap.back() = neighbor;
+		std::push_heap(heap.begin(), heap.end(), closer);
 	}
 }
 
-template <typename T>
-KDTree<T>::KDTree(unsigned dim) : root(nullptr), dimension(dim)
+/******************************************************************************/
+/*!
+
+Orders the neighbors from the closest to the farthest. Their distances are
+still the reduced distances of the search.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::NeighborHeap::sort()
 {
+	std::sort_heap(heap.begin(), heap.end(), closer);
+}
 
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::NeighborHeap::closer(const Neighbor& lhs, const Neighbor& rhs)
+{
+	return lhs.distance < rhs.distance;
 }
 
-template <typename T>
-KDTree<T>::~KDTree()
+template <typename T, unsigned int Dim, typename Metric>
+KDTree<T, Dim, Metric>::SearchState::SearchState(NeighborHeap& heap, const SearchLimits& limits) : champions(heap), factor(1.0), leavesLeft(limits.maxLeaves != 0 ? limits.maxLeaves : std::numeric_limits<size_t>::max()), exact(true)
 {
-	if(root!=nullptr)
-		clear();
-	root = nullptr;
+	for (unsigned int i = 0; i < Metric::power; ++i)
+	{
+		factor *= 1.0 + limits.epsilon;
+	}
+	KDTREE_STAT(counters = QueryStats();)
+}
+
+/******************************************************************************/
+/*!
+
+Tells whether a subtree whose cell is at reduced distance "cellDistance" from
+the query has to be searched. An exact search skips it only when it cannot
+hold a point closer than the farthest champion. An approximate one also skips
+it when its points cannot be (1 + epsilon) times closer, or once no leaf visit
+is left, and then the result is no longer known to be exact.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+inline bool KDTree<T, Dim, Metric>::SearchState::explore(T cellDistance)
+{
+	T worst = champions.worstDistance();
+	if (!(cellDistance < worst))
+	{
+		KDTREE_STAT(++counters.subtreesPruned;)
+		return false;
+	}
+	if (factor == 1.0 && leavesLeft != 0)
+	{
+		return true;
+	}
+	if (leavesLeft == 0 || !(static_cast<double>(cellDistance) * factor < static_cast<double>(worst)))
+	{
+		KDTREE_STAT(++counters.subtreesPruned;)
+		exact = false;
+		return false;
+	}
+	return true;
 }
 
+
 /******************************************************************************/
 /*!
 
-This insert a new node to the KDTree. It takes a node as a parameter and calls a
-helper function "insert" to insert the new node.
+Creates an empty tree of fixed dimension Dim.
 
 */
 /******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+KDTree<T, Dim, Metric>::KDTree() : root(invalidNode), dimension(Dim), metric(), bucketSize(defaultBucketSize), splitRule(SPLIT_CYCLE), garbageRows(0), nodeView(nullptr), coordinateView(nullptr), nodeCount(0), rowCount(0), candidateFactor(2)
+{
+	static_assert(Dim != 0, "the dimension must be given to the constructor when it is not a template argument");
+}
+
+/******************************************************************************/
+/*!
 
-template <typename T>
-void KDTree<T>::insertNewNode(const std::vector<T>& newData)
+Creates an empty tree of dimension "dim" whose leaves hold up to "bucket"
+points and searched with "distanceMetric". If the dimension is a template
+argument "dim" must match it. A metric that does not fit the dimension, such
+as a weighted metric without one weight per dimension, is rejected: the tree
+refuses every point given to it and stays empty.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+KDTree<T, Dim, Metric>::KDTree(unsigned dim, unsigned int bucket, const Metric& distanceMetric) : root(invalidNode), dimension(Dim != 0 ? Dim : dim), metric(distanceMetric), bucketSize(bucket != 0 ? bucket : 1), splitRule(SPLIT_CYCLE), garbageRows(0), nodeView(nullptr), coordinateView(nullptr), nodeCount(0), rowCount(0), candidateFactor(2)
 {
-	unsigned int level = 0;
-	Node * newNodetoInsert = newNode(newData);
-	// this function is a helper function which helps to insert the required node
-	root = insert(root, newNodetoInsert, level);
+	if (Dim != 0 && dim != Dim)
+	{
+		std::cout << "dimension " << dim << " does not match the fixed dimension " << Dim << std::endl;
+	}
+	metricFits();
 }
 
 /******************************************************************************/
 /*!
 
-This function returns root of the tree.
+Copies a tree. The arrays are copied in two blocks, a tree reading a mapped
+binary file shares the mapping instead, so copying it costs nothing until one
+of the two is modified.
 
 */
 /******************************************************************************/
-template <typename T>
-typename KDTree<T>::KDNode* KDTree<T>::getRoot() const
+template <typename T, unsigned int Dim, typename Metric>
+KDTree<T, Dim, Metric>::KDTree(const KDTree& other) : root(other.root), nodes(other.nodes), coordinates(other.coordinates), dimension(other.dimension), metric(other.metric), bucketSize(other.bucketSize), splitRule(other.splitRule), garbageRows(other.garbageRows), freeNodes(other.freeNodes), nodeView(other.nodeView), coordinateView(other.coordinateView), nodeCount(other.nodeCount), rowCount(other.rowCount), mapping(other.mapping), lowPrecision(other.lowPrecision), candidateFactor(other.candidateFactor)
 {
-	return root;
+	updateViews();
 }
 
+template <typename T, unsigned int Dim, typename Metric>
+KDTree<T, Dim, Metric>::~KDTree()
+{
+	if(root!=invalidNode)
+		clear();
+	root = invalidNode;
+}
 
 /******************************************************************************/
 /*!
 
-This function is a helper function to find the newarest neighbor to a given node.
--querypoint		 - is the data whose closest neighbor we want to find.
--currPoint		 - is the node that currently being compared to.
--champion		 - is the node that will hold details about the closest node.// I could have used a simple vector but felt more right using a node.
--closestDistance - this saves the closest distance 
--sd				 - this is actually the splitting dimesion of the data. It is used to calculate to access the correct data to compare the distance
+This insert a new point to the KDTree. It walks down to the leaf whose region
+holds the point and calls a helper function "insert" to add the point to it.
+The point counts of the nodes on the way are updated, and the highest of them
+that the point would put out of balance is rebuilt with the point instead.
 
 */
 /******************************************************************************/
-template <typename T>
-void KDTree<T>::nearestNeighbor(KDNode* queryPoint, KDNode* currPoint, KDNode& champion, T& closestDistance, unsigned sd) const
+
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::insertNewNode(const Point& newData)
 {
-	if (currPoint == NULL)
+	if (newData.size() < dimension)
+	{
+		std::cout << "invalid point, expected " << dimension << " values" << std::endl;
+		return;
+	}
+	if (!metricFits())
 		return;
-	// distance between the current node that is being considered and the query point is calculated
-	T distance = utilities<T>::distance(queryPoint->data, currPoint->data);
-	// if the calculcated distance is less than the distance previously calculated we update the new distance and the node data.
-	if (distance < closestDistance)
+	ensureOwned();
+	lowPrecision.clear();
+	if (root == invalidNode)
 	{
-		closestDistance = distance;
-		champion.data = currPoint->data; 
+		root = newNode();
+		nodes[root].begin = static_cast<unsigned int>(rowCount);
+		nodes[root].count = 0;
 	}
-	unsigned int index = sd % dimension;
-	// this is used to decide whether we need to go to the right or left half of the tree.
-	// if the distance from the query point to the splitting edge is less than the current close distance then we explore the other half,
-	// as there is a chance that we might have another point closer to the given data
-	T distancePointToEdge = static_cast<T>(fabs(queryPoint->data[index] - currPoint->data[index]));
-
-	if (currPoint->data[index] >= queryPoint->data[index])
+	unsigned int currNode = root;
+	unsigned int axis = 0;
+	while (nodes[currNode].axis != leafAxis)
 	{
-		nearestNeighbor(queryPoint, currPoint->left, champion, closestDistance, sd + 1);
-		if (distancePointToEdge <= closestDistance)
+		KDNode& curr = nodes[currNode];
+		// equal values go to the left, the same way the build puts them
+		bool toLeft = newData[curr.axis] <= curr.split;
+		++curr.size;
+		unsigned int larger = std::max(nodes[curr.left].size + (toLeft ? 1 : 0), nodes[curr.right].size + (toLeft ? 0 : 1));
+		if (unbalanced(curr.size, larger))
 		{
-			nearestNeighbor(queryPoint, currPoint->right, champion, closestDistance, sd + 1);
+			rebuild(currNode, newData.data());
+			return;
 		}
+		axis = nextAxis(curr.axis);
+		currNode = toLeft ? curr.left : curr.right;
+	}
+	// this function is a helper function which helps to insert the required point
+	insert(currNode, newData.data(), axis);
+}
+
+/******************************************************************************/
+/*!
+
+Removes one point equal to "data" from the tree. The last point of its leaf
+takes its place, so leaves stay dense and queries never skip dead entries. The
+highest subtree on the way that the removal puts out of balance is rebuilt.
+Returns false if the tree holds no such point.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::remove(const Point& data)
+{
+	if (data.size() < dimension)
+	{
+		std::cout << "invalid point, expected " << dimension << " values" << std::endl;
+		return false;
+	}
+	std::vector<unsigned int>& path = scratchPath;
+	path.clear();
+	unsigned int row = 0;
+	if (root == invalidNode || !locate(root, data.data(), path, row))
+	{
+		return false;
+	}
+	ensureOwned();
+	lowPrecision.clear();
+	const size_t stride = dim();
+	KDNode& leaf = nodes[path.back()];
+	const size_t last = static_cast<size_t>(leaf.begin) + leaf.count - 1;
+	std::copy(coordinates.begin() + last * stride, coordinates.begin() + (last + 1) * stride, coordinates.begin() + static_cast<size_t>(row) * stride);
+	--leaf.count;
+	if ((last + 1) * stride == coordinates.size())
+	{
+		coordinates.resize(last * stride);
 	}
 	else
 	{
-		nearestNeighbor(queryPoint, currPoint->right, champion, closestDistance, sd + 1);
-		if (distancePointToEdge<closestDistance)
+		++garbageRows;
+	}
+	for (size_t i = 0; i < path.size(); ++i)
+	{
+		--nodes[path[i]].size;
+	}
+	updateViews();
+	if (nodes[root].size == 0)
+	{
+		// the arrays are kept for the points inserted next
+		reset();
+		return true;
+	}
+	for (size_t i = 0; i + 1 < path.size(); ++i)
+	{
+		const KDNode& curr = nodes[path[i]];
+		if (unbalanced(curr.size, std::max(nodes[curr.left].size, nodes[curr.right].size)))
 		{
-			nearestNeighbor(queryPoint, currPoint->left, champion, closestDistance, sd + 1);
+			rebuild(path[i], nullptr);
+			return true;
 		}
 	}
+	if (garbageRows > rowCount / 2)
+	{
+		compact();
+	}
+	return true;
 }
 
-
 /******************************************************************************/
 /*!
 
-This function is responsible for writing the tree state to a file.
-
-filename  - this is the name of the file.
-extension - user can save the file in any format
-location  - location to save the tree data.
+Moves a point: removes one point equal to "oldData" and inserts "newData".
+Returns false, leaving the tree unchanged, if there is no point equal to
+"oldData".
 
 */
 /******************************************************************************/
-template <typename T>
-bool KDTree<T>::serialize(const std::string& filename, const std::string& extension, const std::string location) const
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::update(const Point& oldData, const Point& newData)
 {
-
-	if (root == nullptr)
+	if (newData.size() < dimension)
 	{
-		std::cout << "Tree is empty " << std::endl;
+		std::cout << "invalid point, expected " << dimension << " values" << std::endl;
 		return false;
 	}
-	std::vector<std::string > data;
-	// helper function which will recursively called to access all the nodes.
-	helperSerialize(getRoot(), data);
-	return FileIO::getInstance().openFiletoWrite(location + filename, extension, data);
+	if (!remove(oldData))
+	{
+		return false;
+	}
+	insertNewNode(newData);
+	return true;
 }
 
 /******************************************************************************/
 /*!
 
-This function reads the tree from a given file.
+Sets how many points a leaf holds before it is split. Leaves already in the
+tree keep their size until they are split or the tree is rebuilt.
 
-filename - this is the name of the file which contains the saved tree.
-location - this parameter holds the location of the file.  location should always end with "\" or else it will fail to read the file.
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::setBucketSize(unsigned int bucket)
+{
+	bucketSize = bucket != 0 ? bucket : 1;
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+unsigned int KDTree<T, Dim, Metric>::getBucketSize() const
+{
+	return bucketSize;
+}
+
+/******************************************************************************/
+/*!
+
+Sets how the splitting dimension and value of a node are chosen. Like the
+bucket size it applies to the nodes made from then on, by a build, a leaf
+split or a rebuild: build the tree again to apply it to every node. The rule
+is not saved with the tree, the splits are, so a tree read back searches the
+same way whatever the rule of the tree reading it.
 
 */
 /******************************************************************************/
-template <typename T>
-bool KDTree<T>::deSerialize(const std::string& filename, const std::string& location)
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::setSplitRule(SplitRule rule)
 {
-	std::vector<std::string> data = FileIO::getInstance().readFile(location + filename);
-	if (data.size() == 0)
-	{
-		std::cout << "invalid file name " << location + filename << std::endl;
-		return false;
-	}
-	unsigned int  index = 0;
-	root = reConstructTree(getRoot(), data, index);
-	return true;
+	splitRule = rule;
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+SplitRule KDTree<T, Dim, Metric>::getSplitRule() const
+{
+	return splitRule;
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+const Metric& KDTree<T, Dim, Metric>::getMetric() const
+{
+	return metric;
 }
 
 /******************************************************************************/
 /*!
 
-This file constructs a KDTree using the data from the file.
+Makes the nearest neighbor searches scan a copy of the points stored at the
+given precision. A search then gathers "candidates" times more neighbors than
+asked for from the copy and keeps the closest of them by their full precision
+distance, the more candidates the fewer neighbors are missed to the rounding.
+PRECISION_FULL drops the copy. The radius and box searches always use the full
+precision points.
+
+The copy is made from the points as they are, so inserting or removing a point
+drops it. It must be set again once the tree is updated. Returns false if the
+tree is empty or has more than maxLowPrecisionDimension dimensions.
 
 */
 /******************************************************************************/
-template <typename T>
-bool KDTree<T>::buildfromFile(const std::string& fileName, const std::string& location)
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::setPrecision(CoordinatePrecision precision, unsigned int candidates)
 {
-	std::vector<std::string> listPoints;
-	listPoints = FileIO::getInstance().readFile(location + fileName);
-	if (listPoints.size() == 0)
+	lowPrecision.clear();
+	candidateFactor = candidates != 0 ? candidates : 1;
+	if (precision == PRECISION_FULL)
 	{
-		std::cout << "invalid file name " << location + fileName <<  std::endl;
-		return false;
+		return true;
 	}
-	for (unsigned int i = 0; i < listPoints.size(); ++i)
+	if (root == invalidNode || dim() > maxLowPrecisionDimension)
 	{
-		std::vector<T> data = utilities<T>::stringToData(listPoints[i]);
-		insertNewNode(data);
+		std::cout << "a low precision copy needs a tree of 1 to " << maxLowPrecisionDimension << " dimensions holding points" << std::endl;
+		return false;
 	}
-	listPoints.clear();
+	lowPrecision.encode(coordinateView, rowCount, dim(), precision);
 	return true;
 }
 
+template <typename T, unsigned int Dim, typename Metric>
+CoordinatePrecision KDTree<T, Dim, Metric>::getPrecision() const
+{
+	return lowPrecision.precision();
+}
+
 /******************************************************************************/
 /*!
 
-This creates a file given by the user which contains a list of all the closest neighbor queried in the input file.
-queryFilename       -  this is the name of the file which holds the list of data whose nearest neighbor we have to find.
-destinationFileName - this is the name of the file which will be used to save all the nearest neighbor.
+This function returns root of the tree.
 
 */
 /******************************************************************************/
-template <typename T>
-bool KDTree<T>::kNearestNeighbor(const std::string& queryFileName, const std::string& destinationFileName, const std::string& ext) const
+template <typename T, unsigned int Dim, typename Metric>
+unsigned int KDTree<T, Dim, Metric>::getRoot() const
 {
-	std::vector<std::string> source;
-	source = FileIO::getInstance().readFile(queryFileName);
-	if (source.size() == 0)
-	{
-		std::cout << "invalid file name " << queryFileName << std::endl;
-		return false;
-	}
-	std::vector<std::string>::const_iterator iter = source.begin();
-	std::vector<std::string> result;
-	while (iter != source.end())
-	{
-		std::vector<T> data = utilities<T>::stringToData(*iter);
-		Node queryNode(data);
-		Node  closestNode(root->data);
-		T proximity = std::numeric_limits<T>::max();
-		nearestNeighbor(&queryNode, getRoot(), closestNode, proximity, 0);
-		std::string sClosestNode = utilities<T>::dataTostring(closestNode.data);
-		std::string proximityStr = utilities<T>::dataTostring(proximity);
-		result.push_back(sClosestNode + "," + " " + "," + proximityStr);
-		++iter;
-	}
-	return FileIO::getInstance().openFiletoWrite(destinationFileName, ext, result);
+	return root;
 }
 
 /******************************************************************************/
 /*!
 
-Helper function to construct tree
+This function returns the first coordinate of the point stored in a row of the
+coordinates.
 
 */
 /******************************************************************************/
-template <typename T>
-bool KDTree<T>::constructKDTree(const std::vector<KDNode*>& listNodes)
+template <typename T, unsigned int Dim, typename Metric>
+const T* KDTree<T, Dim, Metric>::point(unsigned int row) const
 {
-	int level = 0;
-	for (unsigned int i = 0; i < listNodes.size(); ++i) 
-	{
-		root = insert(root, listNodes[i], level);
-	}
-	return true;
+	return coordinateView + static_cast<size_t>(row) * dim();
 }
 
 /******************************************************************************/
 /*!
 
-Creates a new Node return.
+This function returns a node.
 
 */
 /******************************************************************************/
-template <typename T>
-typename KDTree<T>::KDNode* KDTree<T>::newNode(const std::vector<T>& newData) const
+template <typename T, unsigned int Dim, typename Metric>
+const typename KDTree<T, Dim, Metric>::KDNode& KDTree<T, Dim, Metric>::node(unsigned int index) const
 {
-	KDNode * newNode = new Node(newData);
-	return newNode;
+	return nodeView[index];
 }
 
 /******************************************************************************/
 /*!
 
-This function inserts node at proper places.
+Points the views used by the queries to the owned arrays. It must be called
+whenever the arrays may have moved, a mapped tree keeps its views.
 
 */
 /******************************************************************************/
-template <typename T>
-typename KDTree<T>::KDNode* KDTree<T>::insert(KDNode* currNode, KDNode* newNode, unsigned level) const
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::updateViews()
 {
-	unsigned int index = level % dimension;
-	if (currNode == nullptr)
+	if (mapping)
 	{
-		currNode = newNode;
+		return;
 	}
-	else if (currNode->data[index] >= newNode->data[index])
+	nodeView = nodes.data();
+	coordinateView = coordinates.data();
+	nodeCount = nodes.size();
+	rowCount = coordinates.size() / dim();
+}
+
+/******************************************************************************/
+/*!
+
+Copies a mapped tree to owned arrays so that it can be modified, and releases
+the mapping. Does nothing for a tree that already owns its arrays.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::ensureOwned()
+{
+	if (!mapping)
 	{
-		currNode->left = insert(currNode->left, newNode, level + 1);
+		return;
 	}
-	else
+	nodes.assign(nodeView, nodeView + nodeCount);
+	coordinates.assign(coordinateView, coordinateView + rowCount * dim());
+	mapping.reset();
+	updateViews();
+}
+
+/******************************************************************************/
+/*!
+
+Tells whether the metric can measure points of the dimension of the tree, and
+reports it when it cannot. Every way of adding points to the tree checks it
+first, so a metric that does not fit is never evaluated.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::metricFits() const
+{
+	if (!metric.fits(dim()))
 	{
-		currNode->right = insert(currNode->right, newNode, level + 1);
+		std::cout << "the metric does not fit a tree of " << dim() << " dimensions" << std::endl;
+		return false;
 	}
+	return true;
+}
+
+/******************************************************************************/
+/*!
 
-	return currNode;
+Returns the dimension of the tree. For a fixed dimension tree this is a
+compile time constant, which lets the compiler unroll the loops using it.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+inline unsigned int KDTree<T, Dim, Metric>::dim() const
+{
+	return Dim != 0 ? Dim : dimension;
 }
 
 /******************************************************************************/
 /*!
 
-Used to destroy the tree.
+Returns the splitting dimension used by the children of a node splitting along
+"axis". The dimensions are used in turn, without a modulo per level.
 
 */
 /******************************************************************************/
-template <typename T>
-void KDTree<T>::clear( )
+template <typename T, unsigned int Dim, typename Metric>
+inline unsigned int KDTree<T, Dim, Metric>::nextAxis(unsigned int axis) const
 {
-	delete root;
-	root = nullptr;
+	return axis + 1 == dim() ? 0 : axis + 1;
 }
 
 /******************************************************************************/
 /*!
 
-This function is a helper function to serialize the tree to a file.
+Computes the reduced distance between 2 points of the tree dimension with the
+metric. A fixed dimension is passed to it so that its loop is unrolled.
 
 */
 /******************************************************************************/
-template <typename T>
-void KDTree<T>::helperSerialize(const KDNode* curr, std::vector<std::string>& vecdata) const
+template <typename T, unsigned int Dim, typename Metric>
+inline T KDTree<T, Dim, Metric>::reducedDistance(const T* p1, const T* p2) const
 {
-	if (curr == nullptr)
-	{
-		vecdata.push_back("nullptr");
-		return;
-	}
-	std::string convertedData = utilities<T>::dataTostring(curr->data);
-	vecdata.push_back(convertedData);
-	helperSerialize(curr->left, vecdata);
-	// Note: data has been extended with data from curr->left
-	helperSerialize(curr->right, vecdata);
+	return metric.template distance<Dim>(p1, p2, dimension);
 }
+
+
 /******************************************************************************/
 /*!
 
-Helper function to Deserialize a tree.
+This function is a helper function to find the newarest neighbors to a given point.
+-querypoint		 - is the data whose closest neighbors we want to find.
+-currPoint		 - is the root of the subtree to search.
+-search			 - holds the closest points found so far with their reduced distance. A subtree is only explored if it can hold a point closer than the farthest of them.
+
+The search goes down to the leaf holding the query, pushing the far side of
+each split on a stack. Once a leaf is scanned the far sides are popped, the
+deepest first, and searched only if they can still hold a closer point. This
+visits the nodes in the same order as a recursive search.
+
+A far side is skipped using the distance from the query to its whole cell, the
+box its splits bound it to, and not only to its splitting plane. As in the
+search of Arya and Mount the search keeps, for every dimension, the axis bound
+of the gap from the query to the current cell, 0 while the query is within the
+cell along that dimension. Crossing a split only changes the gap along its
+dimension, so the distance to the far cell is the distance to the current cell
+updated for that one gap, in constant time. Entering a far side pushes a
+restore entry that puts the previous gap back once the far side is done.
 
 */
 /******************************************************************************/
-template <typename T>
-typename KDTree<T>::KDNode* KDTree<T>::reConstructTree(KDNode* curr, const std::vector<std::string>& data, unsigned& index) const
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::nearestNeighbor(const T* queryPoint, unsigned int currPoint, SearchState& search) const
 {
-	std::string line;
-	if (index >= data.size())
+	if (currPoint == invalidNode)
+		return;
+	T fixedOffsets[Dim != 0 ? Dim : offsetCapacity];
+	std::vector<T> heapOffsets;
+	T* offsets = fixedOffsets;
+	if (Dim == 0 && dim() > offsetCapacity)
 	{
-		return nullptr;
+		heapOffsets.resize(dim());
+		offsets = heapOffsets.data();
 	}
-	line = data[index]; 
-	++index;			
-	if (line == "nullptr") // "nullptr" this is just an indicator that this node is null
+	std::fill(offsets, offsets + dim(), T());
+	TraversalStack<PendingNode, stackCapacity> pending;
+	unsigned int depth = 0;
+	// reduced distance from the query to the cell of "currPoint"
+	T cellDistance = T();
+	for (;;)
 	{
-		return nullptr;
+		const KDNode& currNode = node(currPoint);
+		KDTREE_STAT(++search.counters.nodesVisited; search.counters.maxDepth = std::max(search.counters.maxDepth, depth);)
+		if (currNode.axis != leafAxis)
+		{
+			unsigned int index = currNode.axis;
+			// this is used to decide whether we need to go to the right or left half of the tree.
+			// the near half keeps the cell distance of its parent, the far half is farther along "index" only
+			bool toLeft = queryPoint[index] <= currNode.split;
+			// the gap is taken in the order that keeps it positive, which unsigned types need
+			T farBound = metric.axisBound(toLeft ? currNode.split - queryPoint[index] : queryPoint[index] - currNode.split, index);
+			PendingNode farSide = { toLeft ? currNode.right : currNode.left, depth + 1, index, farBound, metric.updateBound(cellDistance, offsets[index], farBound) };
+			pending.push(farSide);
+			currPoint = toLeft ? currNode.left : currNode.right;
+			++depth;
+			continue;
+		}
+		if (search.leavesLeft == 0)
+		{
+			KDTREE_STAT(++search.counters.subtreesPruned;)
+			search.exact = false;
+		}
+		else if (!lowPrecision.empty())
+		{
+			--search.leavesLeft;
+			KDTREE_STAT(search.counters.distanceEvaluations += currNode.count;)
+			scanLowPrecision(queryPoint, currNode, search.champions);
+		}
+		else
+		{
+			--search.leavesLeft;
+			KDTREE_STAT(search.counters.distanceEvaluations += currNode.count;)
+			NeighborHeap& champions = search.champions;
+			// the points of a leaf are contiguous, they are scanned one after the other
+			const T* currData = point(currNode.begin);
+			for (unsigned int i = 0; i < currNode.count; ++i, currData += dim())
+			{
+				// distance between the point that is being considered and the query point is calculated, reduced as only the order matters
+				T distance = reducedDistance(queryPoint, currData);
+				// if the calculcated distance is less than the distance of the farthest champion the point becomes a champion.
+				if (distance < champions.worstDistance())
+				{
+					champions.push(currData, distance);
+				}
+			}
+		}
+		// the far sides are checked against the champions found since they were pushed
+		for (;;)
+		{
+			if (pending.empty())
+				return;
+			PendingNode next = pending.pop();
+			if (next.node == invalidNode)
+			{
+				offsets[next.axis] = next.axisBound;
+				continue;
+			}
+			if (search.explore(next.cellDistance))
+			{
+				PendingNode restore = { invalidNode, next.depth, next.axis, offsets[next.axis], T() };
+				pending.push(restore);
+				offsets[next.axis] = next.axisBound;
+				cellDistance = next.cellDistance;
+				currPoint = next.node;
+				depth = next.depth;
+				break;
+			}
+		}
 	}
-	std::vector<T> point = utilities<T>::stringToData(line);
-	curr = newNode(point);
+}
 
-	curr->left = reConstructTree(curr->left, data, index);
-	// NOTE: index is passed by reference and is now different
-	curr->right = reConstructTree(curr->right, data, index);
-	return curr;
+/******************************************************************************/
+/*!
+
+Scans a leaf in the low precision copy. Each point is decoded in a buffer on
+the stack and compared to the query, the champions point to the full precision
+rows so that they can be ranked again.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::scanLowPrecision(const T* queryPoint, const KDNode& leaf, NeighborHeap& champions) const
+{
+	T decoded[Dim != 0 ? Dim : maxLowPrecisionDimension];
+	const T* currData = point(leaf.begin);
+	for (unsigned int i = 0; i < leaf.count; ++i, currData += dim())
+	{
+		lowPrecision.decode(static_cast<size_t>(leaf.begin) + i, decoded);
+		T distance = reducedDistance(queryPoint, decoded);
+		if (distance < champions.worstDistance())
+		{
+			champions.push(currData, distance);
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Returns the k closest points to the query ordered from the closest to the
+farthest, along with their distance. Fewer than k results are returned if the
+tree holds fewer than k points. The query must have "dimension" coordinates.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+std::vector<typename KDTree<T, Dim, Metric>::Neighbor> KDTree<T, Dim, Metric>::knn(const T* query, size_t k) const
+{
+	std::vector<Neighbor> result;
+	SearchLimits limits = { 0.0, 0 };
+	approximateKnn(query, k, limits, result);
+	return result;
+}
+
+/******************************************************************************/
+/*!
+
+Same as above, keeping only the points closer than "maxDistance". Fewer than k
+results are returned if fewer points are that close. The subtrees farther than
+"maxDistance" are skipped from the start, so a caller already holding
+neighbors from elsewhere, such as another shard of a forest, pays much less
+than for a full search.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+std::vector<typename KDTree<T, Dim, Metric>::Neighbor> KDTree<T, Dim, Metric>::knn(const T* query, size_t k, T maxDistance) const
+{
+	std::vector<Neighbor> result;
+	SearchLimits limits = { 0.0, 0 };
+	boundedKnn(query, k, metric.toReduced(maxDistance), limits, result, nullptr);
+	return result;
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+std::vector<typename KDTree<T, Dim, Metric>::Neighbor> KDTree<T, Dim, Metric>::knn(const Point& query, size_t k) const
+{
+	if (query.size() < dimension)
+	{
+		std::cout << "invalid query, expected " << dimension << " values" << std::endl;
+		return std::vector<Neighbor>();
+	}
+	return knn(query.data(), k);
+}
+
+/******************************************************************************/
+/*!
+
+Finds k neighbors of the query within the given limits and stores them in
+"result", closest first. With an epsilon the distance of the i-th neighbor is
+at most (1 + epsilon) times the distance of the true i-th closest point. With
+a leaf budget the cost of a query is bounded, but neighbors in leaves left
+unvisited are missed. Returns true if the result is guaranteed to be exact,
+which is the case when no subtree that could hold a closer point was skipped.
+If "stats" is not null it receives the work done by the search.
+
+With a low precision copy, k times "candidateFactor" candidates are gathered
+from it and the k closest by their full precision distance are kept. Those
+distances are exact but a neighbor the rounding pushed out of the candidates
+is missed, so the result is never reported as exact.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::approximateKnn(const T* query, size_t k, const SearchLimits& limits, std::vector<Neighbor>& result, QueryStats* stats) const
+{
+	return boundedKnn(query, k, std::numeric_limits<T>::max(), limits, result, stats);
+}
+
+/******************************************************************************/
+/*!
+
+Helper function of the nearest neighbor searches. Searches as "approximateKnn"
+for neighbors whose reduced distance is below "bound", which prunes the
+subtrees farther than that from the start. The low precision copy gathers its
+candidates without the bound, their full precision distances are checked
+against it.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::boundedKnn(const T* query, size_t k, T bound, const SearchLimits& limits, std::vector<Neighbor>& result, QueryStats* stats) const
+{
+	const bool reRank = !lowPrecision.empty();
+	NeighborHeap champions(result, reRank ? k * candidateFactor : k, reRank ? std::numeric_limits<T>::max() : bound);
+	if (stats != nullptr)
+	{
+		*stats = QueryStats();
+	}
+	if (k == 0)
+	{
+		return true;
+	}
+	SearchState search(champions, limits);
+	nearestNeighbor(query, getRoot(), search);
+	if (reRank)
+	{
+		for (size_t i = 0; i < result.size(); ++i)
+		{
+			result[i].distance = reducedDistance(query, result[i].point);
+		}
+		KDTREE_STAT(search.counters.distanceEvaluations += result.size();)
+		size_t kept = std::min(k, result.size());
+		std::partial_sort(result.begin(), result.begin() + kept, result.end(), [](const Neighbor& lhs, const Neighbor& rhs)
+		{
+			return lhs.distance < rhs.distance;
+		});
+		while (kept != 0 && !(result[kept - 1].distance < bound))
+			--kept;
+		result.resize(kept);
+		search.exact = false;
+	}
+	else
+	{
+		champions.sort();
+	}
+	for (size_t i = 0; i < result.size(); ++i)
+	{
+		result[i].distance = metric.fromReduced(result[i].distance);
+	}
+	KDTREE_STAT(if (stats != nullptr) *stats = search.counters;)
+	return search.exact;
+}
+
+
+/******************************************************************************/
+/*!
+
+Finds the k closest neighbors of every point of a batch of queries. The queries
+are stored row by row, "dimension" coordinates each, and the neighbors of query
+i are written closest first to results[i * k] up to results[i * k + k - 1].
+Slots left over when the tree has fewer than k points get a null point and the
+largest distance. "results" must hold queryCount * k neighbors.
+
+The queries are spread over "threadCount" threads, all the hardware threads if
+it is 0. The tree is only read, so the threads share it without locking.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::knnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, unsigned int threadCount) const
+{
+	ThreadPool pool(threadCount);
+	knnBatch(queries, queryCount, k, results, pool);
+}
+
+/******************************************************************************/
+/*!
+
+Same as above on the threads of an existing pool, which saves starting threads
+when many batches are run.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::knnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, ThreadPool& pool) const
+{
+	SearchLimits limits = { 0.0, 0 };
+	approximateKnnBatch(queries, queryCount, k, results, limits, nullptr, pool);
+}
+
+/******************************************************************************/
+/*!
+
+Runs "approximateKnn" on every query of a batch on the threads of "pool". The
+results are laid out as for "knnBatch". If "exact" is not null, exact[i] tells
+whether the result of query i is guaranteed to be exact. Returns how many
+results are. If "stats" is not null it receives the work done by all the
+queries added up, "maxDepth" being the deepest of them.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+size_t KDTree<T, Dim, Metric>::approximateKnnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, const SearchLimits& limits, bool* exact, ThreadPool& pool, QueryStats* stats) const
+{
+	if (stats != nullptr)
+	{
+		*stats = QueryStats();
+	}
+	if (k == 0)
+	{
+		std::fill(exact, exact + (exact != nullptr ? queryCount : 0), true);
+		return queryCount;
+	}
+	const size_t stride = dim();
+	std::atomic<size_t> exactCount(0);
+	std::mutex statsLock;
+	// small chunks so that threads finishing early can steal work from slow ones
+	size_t grain = queryCount / (static_cast<size_t>(pool.size()) * 16);
+	grain = std::max<size_t>(1, std::min<size_t>(grain, 256));
+	pool.parallelFor(queryCount, grain, [this, queries, k, results, stride, &limits, exact, &exactCount, stats, &statsLock](size_t begin, size_t end)
+	{
+		Neighbor missing;
+		missing.point = nullptr;
+		missing.distance = std::numeric_limits<T>::max();
+		// one heap storage per chunk, reused by each of its queries
+		std::vector<Neighbor> closest;
+		size_t found = 0;
+		QueryStats total = QueryStats();
+		QueryStats query;
+		for (size_t i = begin; i < end; ++i)
+		{
+			bool isExact = approximateKnn(queries + i * stride, k, limits, closest, stats != nullptr ? &query : nullptr);
+			if (stats != nullptr)
+			{
+				total.nodesVisited += query.nodesVisited;
+				total.distanceEvaluations += query.distanceEvaluations;
+				total.subtreesPruned += query.subtreesPruned;
+				total.maxDepth = std::max(total.maxDepth, query.maxDepth);
+			}
+			Neighbor* slots = results + i * k;
+			std::copy(closest.begin(), closest.end(), slots);
+			std::fill(slots + closest.size(), slots + k, missing);
+			if (exact != nullptr)
+				exact[i] = isExact;
+			found += isExact ? 1 : 0;
+		}
+		exactCount += found;
+		if (stats != nullptr)
+		{
+			std::lock_guard<std::mutex> guard(statsLock);
+			stats->nodesVisited += total.nodesVisited;
+			stats->distanceEvaluations += total.distanceEvaluations;
+			stats->subtreesPruned += total.subtreesPruned;
+			stats->maxDepth = std::max(stats->maxDepth, total.maxDepth);
+		}
+	});
+	return exactCount.load();
+}
+
+/******************************************************************************/
+/*!
+
+Finds the k closest neighbors of every query of a batch with a dual tree
+search. The results are laid out as for "knnBatch" and are exact.
+
+A temporary tree is built over the queries and walked together with this tree:
+a pair of a query node and a reference node is skipped at once when the boxes
+of their points are farther apart than the farthest neighbor found so far by
+any query of the query node. Queries close to each other share the work of
+reaching the same part of this tree, and every pair of leaves is compared once
+for all their queries. This pays off for large batches of queries that are
+close to each other or to the points, where the separate searches of
+"knnBatch" would repeat the same descents. The low precision copy, if any, is
+not used.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::dualTreeKnnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, unsigned int threadCount) const
+{
+	ThreadPool pool(threadCount);
+	dualTreeKnnBatch(queries, queryCount, k, results, pool);
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::dualTreeKnnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, ThreadPool& pool) const
+{
+	if (k == 0 || queryCount == 0)
+	{
+		return;
+	}
+	Neighbor missing;
+	missing.point = nullptr;
+	missing.distance = std::numeric_limits<T>::max();
+	if (root == invalidNode)
+	{
+		std::fill(results, results + queryCount * k, missing);
+		return;
+	}
+	const size_t stride = dim();
+	std::vector<T> source(queries, queries + queryCount * stride);
+	std::vector<unsigned int> order(queryCount);
+	for (size_t i = 0; i < queryCount; ++i)
+	{
+		order[i] = static_cast<unsigned int>(i);
+	}
+	// the build leaves row i of the query tree holding query order[i]
+	KDTree queryTree(dim(), bucketSize, metric);
+	queryTree.constructKDTree(source, order);
+	std::vector<Neighbor> heaps(queryCount * k);
+	std::vector<unsigned int> heapSizes(queryCount, 0);
+	dualTreeKnn(queryTree, k, false, heaps.data(), heapSizes.data(), pool);
+	for (size_t row = 0; row < queryCount; ++row)
+	{
+		Neighbor* slots = results + static_cast<size_t>(order[row]) * k;
+		std::copy(heaps.begin() + row * k, heaps.begin() + row * k + heapSizes[row], slots);
+		std::fill(slots + heapSizes[row], slots + k, missing);
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Finds the k closest other points of every point of the tree, the self join a
+deduplication needs: a point is never its own neighbor, but a duplicate of it
+is, at distance 0. "points" receives every point of the tree, leaf after leaf,
+and the neighbors of points[i] are written closest first to results[i * k] up
+to results[i * k + k - 1]. Slots left over when the tree has k points or fewer
+get a null point and the largest distance. Returns the number of points.
+
+The tree is its own query tree, so nothing is built: the dual tree search of
+"dualTreeKnnBatch" runs with the same tree on both sides.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+size_t KDTree<T, Dim, Metric>::allNearestNeighbors(size_t k, std::vector<const T*>& points, std::vector<Neighbor>& results, unsigned int threadCount) const
+{
+	ThreadPool pool(threadCount);
+	return allNearestNeighbors(k, points, results, pool);
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+size_t KDTree<T, Dim, Metric>::allNearestNeighbors(size_t k, std::vector<const T*>& points, std::vector<Neighbor>& results, ThreadPool& pool) const
+{
+	points.clear();
+	results.clear();
+	if (root == invalidNode)
+	{
+		return 0;
+	}
+	std::vector<Neighbor> heaps(rowCount * k);
+	std::vector<unsigned int> heapSizes(rowCount, 0);
+	dualTreeKnn(*this, k, true, heaps.data(), heapSizes.data(), pool);
+	Neighbor missing;
+	missing.point = nullptr;
+	missing.distance = std::numeric_limits<T>::max();
+	points.reserve(node(root).size);
+	results.reserve(static_cast<size_t>(node(root).size) * k);
+	TraversalStack<unsigned int, stackCapacity> pending;
+	pending.push(root);
+	while (!pending.empty())
+	{
+		const KDNode& currNode = node(pending.pop());
+		if (currNode.axis != leafAxis)
+		{
+			pending.push(currNode.right);
+			pending.push(currNode.left);
+			continue;
+		}
+		for (unsigned int i = 0; i < currNode.count; ++i)
+		{
+			const size_t row = static_cast<size_t>(currNode.begin) + i;
+			points.push_back(point(static_cast<unsigned int>(row)));
+			results.insert(results.end(), heaps.begin() + row * k, heaps.begin() + row * k + heapSizes[row]);
+			results.insert(results.end(), k - heapSizes[row], missing);
+		}
+	}
+	return points.size();
+}
+
+/******************************************************************************/
+/*!
+
+Computes the box of the points of every node: boxes[n * 2 * dim] holds the
+lowest value of each axis over the points of node n, followed by the highest.
+The box of an empty node has every low above its high. parents[n] is the
+parent of node n, invalidNode for the root and the unused nodes.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::nodeBoxes(std::vector<T>& boxes, std::vector<unsigned int>& parents) const
+{
+	const size_t stride = dim();
+	boxes.assign(nodeCount * 2 * stride, T());
+	parents.assign(nodeCount, static_cast<unsigned int>(invalidNode));
+	if (root == invalidNode)
+	{
+		return;
+	}
+	// preorder lists every node before its children, so the boxes are merged walking it backwards
+	std::vector<unsigned int> order;
+	order.reserve(nodeCount);
+	TraversalStack<unsigned int, stackCapacity> pending;
+	pending.push(root);
+	while (!pending.empty())
+	{
+		unsigned int curr = pending.pop();
+		order.push_back(curr);
+		const KDNode& currNode = node(curr);
+		if (currNode.axis != leafAxis)
+		{
+			parents[currNode.left] = curr;
+			parents[currNode.right] = curr;
+			pending.push(currNode.right);
+			pending.push(currNode.left);
+		}
+	}
+	for (size_t i = order.size(); i-- > 0;)
+	{
+		const KDNode& currNode = node(order[i]);
+		T* low = &boxes[order[i] * 2 * stride];
+		T* high = low + stride;
+		std::fill(low, high, std::numeric_limits<T>::max());
+		std::fill(high, high + stride, std::numeric_limits<T>::lowest());
+		if (currNode.axis == leafAxis)
+		{
+			const T* currData = point(currNode.begin);
+			for (unsigned int j = 0; j < currNode.count; ++j, currData += stride)
+			{
+				for (size_t a = 0; a < stride; ++a)
+				{
+					low[a] = std::min(low[a], currData[a]);
+					high[a] = std::max(high[a], currData[a]);
+				}
+			}
+			continue;
+		}
+		const T* left = &boxes[currNode.left * 2 * stride];
+		const T* right = &boxes[currNode.right * 2 * stride];
+		for (size_t a = 0; a < stride; ++a)
+		{
+			low[a] = std::min(left[a], right[a]);
+			high[a] = std::max(left[stride + a], right[stride + a]);
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Returns the reduced distance between the closest points of 2 boxes laid out as
+by "nodeBoxes", 0 if they overlap. The 2 closest points are built in "closest",
+which must hold 2 * dim values, and measured with the metric, which holds for
+every metric growing with the difference along each axis.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+inline T KDTree<T, Dim, Metric>::boxDistance(const T* first, const T* second, T* closest) const
+{
+	const unsigned int stride = dim();
+	T* firstPoint = closest;
+	T* secondPoint = closest + stride;
+	for (unsigned int a = 0; a < stride; ++a)
+	{
+		if (first[stride + a] < second[a])
+		{
+			firstPoint[a] = first[stride + a];
+			secondPoint[a] = second[a];
+		}
+		else if (second[stride + a] < first[a])
+		{
+			firstPoint[a] = first[a];
+			secondPoint[a] = second[stride + a];
+		}
+		else
+		{
+			firstPoint[a] = secondPoint[a] = first[a];
+		}
+	}
+	return reducedDistance(firstPoint, secondPoint);
+}
+
+/******************************************************************************/
+/*!
+
+Helper function of the dual tree searches. Finds, for every row of
+"queryTree", the k closest points of this tree and keeps them in a max-heap of
+reduced distances at heaps[row * k], heapSizes[row] being the number of
+neighbors found. The heaps are then sorted closest first and their distances
+turned back. With "self" the query tree is this tree and a point is not a
+neighbor of itself.
+
+The query tree is cut into subtrees, the largest split first until every
+thread of the pool has several, and each subtree is searched on its own
+against the whole of this tree.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::dualTreeKnn(const KDTree& queryTree, size_t k, bool self, Neighbor* heaps, unsigned int* heapSizes, ThreadPool& pool) const
+{
+	if (k == 0 || root == invalidNode || queryTree.root == invalidNode)
+	{
+		return;
+	}
+	std::vector<T> referenceBoxes;
+	std::vector<unsigned int> referenceParents;
+	nodeBoxes(referenceBoxes, referenceParents);
+	std::vector<T> queryBoxes;
+	std::vector<unsigned int> queryParents;
+	if (!self)
+	{
+		queryTree.nodeBoxes(queryBoxes, queryParents);
+	}
+	const T* queryBoxView = self ? referenceBoxes.data() : queryBoxes.data();
+	const unsigned int* queryParentView = self ? referenceParents.data() : queryParents.data();
+	// bounds[n] is the distance a point must beat to become a neighbor of every query of node n
+	std::vector<T> bounds(queryTree.nodeCount, std::numeric_limits<T>::max());
+	std::vector<unsigned int> subtrees(1, queryTree.root);
+	const size_t wanted = static_cast<size_t>(pool.size()) * 8;
+	while (subtrees.size() < wanted)
+	{
+		size_t largest = subtrees.size();
+		for (size_t i = 0; i < subtrees.size(); ++i)
+		{
+			const KDNode& candidate = queryTree.node(subtrees[i]);
+			if (candidate.axis != leafAxis && (largest == subtrees.size() || candidate.size > queryTree.node(subtrees[largest]).size))
+				largest = i;
+		}
+		if (largest == subtrees.size())
+			break;
+		const KDNode& split = queryTree.node(subtrees[largest]);
+		subtrees[largest] = split.left;
+		subtrees.push_back(split.right);
+	}
+	Neighbor* heapView = heaps;
+	unsigned int* sizeView = heapSizes;
+	T* boundView = bounds.data();
+	pool.parallelFor(subtrees.size(), 1, [this, &queryTree, &subtrees, queryBoxView, queryParentView, &referenceBoxes, k, self, heapView, sizeView, boundView](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			dualTreeSearch(queryTree, subtrees[i], queryBoxView, queryParentView, referenceBoxes.data(), k, self, heapView, sizeView, boundView);
+		}
+	});
+	const size_t rows = queryTree.rowCount;
+	const Metric& distanceMetric = metric;
+	pool.parallelFor(rows, 4096, [heapView, sizeView, k, &distanceMetric](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; ++row)
+		{
+			Neighbor* heap = heapView + row * k;
+			std::sort_heap(heap, heap + sizeView[row], [](const Neighbor& lhs, const Neighbor& rhs)
+			{
+				return lhs.distance < rhs.distance;
+			});
+			for (unsigned int i = 0; i < sizeView[row]; ++i)
+			{
+				heap[i].distance = distanceMetric.fromReduced(heap[i].distance);
+			}
+		}
+	});
+}
+
+/******************************************************************************/
+/*!
+
+Helper function of the dual tree searches. Walks the pairs of a node of the
+subtree "queryRoot" of the query tree and a node of this tree, starting from
+that subtree and the root. A pair is dropped when the distance between the
+boxes of its nodes is not below the bound of its query node, the distance of
+the farthest neighbor found by any of its queries. Otherwise the query node is
+split first, down to its leaves, and then the reference node, its closer child
+being paired first so that it lowers the bound before the farther one is looked
+at. A pair of leaves compares each query to the points of the reference leaf,
+skipping the leaf for the queries whose own distance to its box is not below
+their farthest neighbor.
+
+The query side is split first because the bound of a query node only becomes
+finite once every one of its queries has k neighbors: splitting the larger
+node of each pair, as a textbook dual tree search does, leaves the upper query
+nodes without a bound for most of the search and prunes nothing there.
+
+Once the bound of a query leaf drops, the bounds of its ancestors within the
+subtree, the largest bound of their children, are lowered with it. Subtrees
+searched on other threads touch other queries and other bounds.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::dualTreeSearch(const KDTree& queryTree, unsigned int queryRoot, const T* queryBoxes, const unsigned int* queryParents, const T* referenceBoxes, size_t k, bool self, Neighbor* heaps, unsigned int* heapSizes, T* bounds) const
+{
+	const unsigned int stride = dim();
+	const size_t boxStride = 2 * static_cast<size_t>(stride);
+	std::vector<T> closest(boxStride);
+	TraversalStack<PendingPair, stackCapacity> pending;
+	// a pair is only kept if its nodes hold points and it may still improve a neighbor
+	auto enqueue = [this, &queryTree, &pending, bounds](unsigned int query, unsigned int reference, T distance)
+	{
+		if (distance < bounds[query] && queryTree.node(query).size != 0 && node(reference).size != 0)
+		{
+			PendingPair pair = { query, reference, distance };
+			pending.push(pair);
+		}
+	};
+	auto closer = [](const Neighbor& lhs, const Neighbor& rhs)
+	{
+		return lhs.distance < rhs.distance;
+	};
+	enqueue(queryRoot, root, boxDistance(queryBoxes + queryRoot * boxStride, referenceBoxes + root * boxStride, closest.data()));
+	while (!pending.empty())
+	{
+		PendingPair next = pending.pop();
+		// the bound may have dropped since the pair was pushed
+		if (!(next.distance < bounds[next.query]))
+			continue;
+		const KDNode& queryNode = queryTree.node(next.query);
+		const KDNode& referenceNode = node(next.reference);
+		const bool queryLeaf = queryNode.axis == leafAxis;
+		const bool referenceLeaf = referenceNode.axis == leafAxis;
+		if (!referenceLeaf && queryLeaf)
+		{
+			const T* queryBox = queryBoxes + next.query * boxStride;
+			const T leftDistance = boxDistance(queryBox, referenceBoxes + referenceNode.left * boxStride, closest.data());
+			const T rightDistance = boxDistance(queryBox, referenceBoxes + referenceNode.right * boxStride, closest.data());
+			// the pair pushed last is searched first
+			if (leftDistance <= rightDistance)
+			{
+				enqueue(next.query, referenceNode.right, rightDistance);
+				enqueue(next.query, referenceNode.left, leftDistance);
+			}
+			else
+			{
+				enqueue(next.query, referenceNode.left, leftDistance);
+				enqueue(next.query, referenceNode.right, rightDistance);
+			}
+			continue;
+		}
+		if (!queryLeaf)
+		{
+			const T* referenceBox = referenceBoxes + next.reference * boxStride;
+			enqueue(queryNode.right, next.reference, boxDistance(queryBoxes + queryNode.right * boxStride, referenceBox, closest.data()));
+			enqueue(queryNode.left, next.reference, boxDistance(queryBoxes + queryNode.left * boxStride, referenceBox, closest.data()));
+			continue;
+		}
+		const T* low = referenceBoxes + next.reference * boxStride;
+		const T* high = low + stride;
+		T bound = T();
+		const T* queryData = queryTree.point(queryNode.begin);
+		for (unsigned int i = 0; i < queryNode.count; ++i, queryData += stride)
+		{
+			const size_t row = static_cast<size_t>(queryNode.begin) + i;
+			Neighbor* heap = heaps + row * k;
+			unsigned int& size = heapSizes[row];
+			T worst = size < k ? std::numeric_limits<T>::max() : heap[0].distance;
+			for (unsigned int a = 0; a < stride; ++a)
+			{
+				closest[a] = std::min(std::max(queryData[a], low[a]), high[a]);
+			}
+			if (reducedDistance(queryData, closest.data()) < worst)
+			{
+				const T* referenceData = point(referenceNode.begin);
+				for (unsigned int j = 0; j < referenceNode.count; ++j, referenceData += stride)
+				{
+					if (self && referenceData == queryData)
+						continue;
+					T distance = reducedDistance(queryData, referenceData);
+					if (!(distance < worst))
+						continue;
+					Neighbor neighbor;
+					neighbor.point = referenceData;
+					neighbor.distance = distance;
+					if (size < k)
+					{
+						heap[size++] = neighbor;
+						std::push_heap(heap, heap + size, closer);
+					}
+					else
+					{
+						std::pop_heap(heap, heap + size, closer);
+						heap[size - 1] = neighbor;
+						std::push_heap(heap, heap + size, closer);
+					}
+					worst = size < k ? std::numeric_limits<T>::max() : heap[0].distance;
+				}
+			}
+			bound = std::max(bound, worst);
+		}
+		unsigned int curr = next.query;
+		bounds[curr] = bound;
+		while (curr != queryRoot)
+		{
+			const unsigned int parent = queryParents[curr];
+			const KDNode& parentNode = queryTree.node(parent);
+			const T merged = std::max(bounds[parentNode.left], bounds[parentNode.right]);
+			if (!(merged < bounds[parent]))
+				break;
+			bounds[parent] = merged;
+			curr = parent;
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Helper function for the radius query. Every point of the subtree whose distance
+to the query is at most "radius" is passed to the callback. The search compares
+reduced distances, and skips a child when the bound of the metric for the gap
+to the splitting plane is beyond the radius, as no point on the other side of
+it can be within range.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+template <typename Callback>
+void KDTree<T, Dim, Metric>::radiusSearch(const T* queryPoint, T radius, unsigned int currPoint, Callback& callback, size_t& found) const
+{
+	if (currPoint == invalidNode)
+		return;
+	const T reducedRadius = metric.toReduced(radius);
+	TraversalStack<unsigned int, stackCapacity> pending;
+	pending.push(currPoint);
+	while (!pending.empty())
+	{
+		const KDNode& currNode = node(pending.pop());
+		if (currNode.axis == leafAxis)
+		{
+			const T* currData = point(currNode.begin);
+			for (unsigned int i = 0; i < currNode.count; ++i, currData += dim())
+			{
+				T distance = reducedDistance(queryPoint, currData);
+				if (distance <= reducedRadius)
+				{
+					callback(currData, metric.fromReduced(distance));
+					++found;
+				}
+			}
+			continue;
+		}
+		unsigned int index = currNode.axis;
+		// the left subtree only holds values less or equal to the split and the right one values greater or equal to it,
+		// the side of the query is always searched and the other one if the plane is within range.
+		// the right side is pushed first so that the left one is visited first
+		const bool toLeft = queryPoint[index] <= currNode.split;
+		const bool crossPlane = metric.axisBound(toLeft ? currNode.split - queryPoint[index] : queryPoint[index] - currNode.split, index) <= reducedRadius;
+		if (!toLeft || crossPlane)
+		{
+			pending.push(currNode.right);
+		}
+		if (toLeft || crossPlane)
+		{
+			pending.push(currNode.left);
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Helper function for the box query. Every point of the subtree inside the box
+[low, high] is passed to the callback. A child is skipped when the box lies
+entirely on the other side of the splitting plane.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+template <typename Callback>
+void KDTree<T, Dim, Metric>::boxSearch(const T* low, const T* high, unsigned int currPoint, Callback& callback, size_t& found) const
+{
+	if (currPoint == invalidNode)
+		return;
+	TraversalStack<unsigned int, stackCapacity> pending;
+	pending.push(currPoint);
+	while (!pending.empty())
+	{
+		const KDNode& currNode = node(pending.pop());
+		if (currNode.axis == leafAxis)
+		{
+			const T* currData = point(currNode.begin);
+			for (unsigned int j = 0; j < currNode.count; ++j, currData += dim())
+			{
+				bool inside = true;
+				for (unsigned int i = 0; i < dim() && inside; ++i)
+				{
+					inside = low[i] <= currData[i] && currData[i] <= high[i];
+				}
+				if (inside)
+				{
+					callback(currData);
+					++found;
+				}
+			}
+			continue;
+		}
+		unsigned int index = currNode.axis;
+		if (high[index] >= currNode.split)
+		{
+			pending.push(currNode.right);
+		}
+		if (low[index] <= currNode.split)
+		{
+			pending.push(currNode.left);
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Calls "callback(point, distance)" for every point whose distance to the query
+is at most "radius" and returns how many points were found. The points are
+reported in tree order as they are found, nothing is collected on the way.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+template <typename Callback>
+size_t KDTree<T, Dim, Metric>::radiusSearch(const T* query, T radius, Callback callback) const
+{
+	size_t found = 0;
+	radiusSearch(query, radius, getRoot(), callback, found);
+	return found;
+}
+
+/******************************************************************************/
+/*!
+
+Appends every point whose distance to the query is at most "radius" to the
+result and returns how many points were appended. The result is not cleared,
+so the same buffer can be reused across queries.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+size_t KDTree<T, Dim, Metric>::radiusSearch(const T* query, T radius, std::vector<Neighbor>& result) const
+{
+	return radiusSearch(query, radius, [&result](const T* currPoint, T distance)
+	{
+		Neighbor neighbor;
+		neighbor.point = currPoint;
+		neighbor.distance = distance;
+		result.push_back(neighbor);
+	});
+}
+
+/******************************************************************************/
+/*!
+
+Calls "callback(point)" for every point inside the axis aligned box [low, high],
+bounds included, and returns how many points were found.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+template <typename Callback>
+size_t KDTree<T, Dim, Metric>::boxSearch(const T* low, const T* high, Callback callback) const
+{
+	size_t found = 0;
+	boxSearch(low, high, getRoot(), callback, found);
+	return found;
+}
+
+/******************************************************************************/
+/*!
+
+Appends every point inside the axis aligned box [low, high] to the result and
+returns how many points were appended. The result is not cleared.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+size_t KDTree<T, Dim, Metric>::boxSearch(const T* low, const T* high, std::vector<const T*>& result) const
+{
+	return boxSearch(low, high, [&result](const T* currPoint)
+	{
+		result.push_back(currPoint);
+	});
+}
+
+/******************************************************************************/
+/*!
+
+Walks the whole tree and reports its shape. A tree built in one go has its
+leaves on one or two depths and every split close to 0.5. A height or a
+worst balance growing with insertions tells that the tree is degenerating
+faster than the rebuilds repair it.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+typename KDTree<T, Dim, Metric>::TreeStats KDTree<T, Dim, Metric>::stats() const
+{
+	TreeStats result = TreeStats();
+	result.axisSplits.assign(dim(), 0);
+	result.axisBalance.assign(dim(), 0.0);
+	result.freeNodeCount = freeNodes.size();
+	result.garbageRows = garbageRows;
+	result.memoryBytes = sizeof(*this) + lowPrecision.bytes() + nodes.capacity() * sizeof(KDNode) + (coordinates.capacity() + scratchPoints.capacity()) * sizeof(T)
+		+ (freeNodes.capacity() + scratchRows.capacity() + scratchPath.capacity()) * sizeof(unsigned int);
+	result.mappedBytes = mapping ? mapping->size() : 0;
+	if (root == invalidNode)
+	{
+		return result;
+	}
+	collectStats(root, 0, result);
+	for (unsigned int i = 0; i < dim(); ++i)
+	{
+		if (result.axisSplits[i] != 0)
+		{
+			result.axisBalance[i] /= static_cast<double>(result.axisSplits[i]);
+		}
+	}
+	if (result.pointCount != 0)
+	{
+		result.averageDepth /= static_cast<double>(result.pointCount);
+	}
+	return result;
+}
+
+/******************************************************************************/
+/*!
+
+Helper function of "stats". Adds the nodes of a subtree to the counts, the
+balance of each inner node is read from the point counts of its children.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::collectStats(unsigned int currNode, unsigned int depth, TreeStats& stats) const
+{
+	TraversalStack<PendingDepth, stackCapacity> pending;
+	PendingDepth start = { currNode, depth };
+	pending.push(start);
+	while (!pending.empty())
+	{
+		PendingDepth next = pending.pop();
+		const KDNode& currData = node(next.node);
+		if (currData.axis == leafAxis)
+		{
+			++stats.leafCount;
+			stats.pointCount += currData.count;
+			stats.height = std::max(stats.height, next.depth);
+			stats.averageDepth += static_cast<double>(next.depth) * currData.count;
+			if (stats.leafDepths.size() <= next.depth)
+			{
+				stats.leafDepths.resize(next.depth + 1, 0);
+			}
+			++stats.leafDepths[next.depth];
+			continue;
+		}
+		++stats.innerNodeCount;
+		if (currData.size != 0)
+		{
+			unsigned int larger = std::max(node(currData.left).size, node(currData.right).size);
+			double share = static_cast<double>(larger) / currData.size;
+			++stats.axisSplits[currData.axis];
+			stats.axisBalance[currData.axis] += share;
+			stats.worstBalance = std::max(stats.worstBalance, share);
+		}
+		PendingDepth right = { currData.right, next.depth + 1 };
+		PendingDepth left = { currData.left, next.depth + 1 };
+		pending.push(right);
+		pending.push(left);
+	}
+}
+
+
+/******************************************************************************/
+/*!
+
+This function is responsible for writing the tree state to a file. The nodes
+are written in preorder, one "split,<axis>,<value>" line per inner node and
+one "leaf,<count>" line per leaf followed by the points of the leaf.
+
+filename  - this is the name of the file.
+extension - user can save the file in any format
+location  - location to save the tree data.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::serialize(const std::string& filename, const std::string& extension, const std::string location) const
+{
+
+	if (root == invalidNode)
+	{
+		std::cout << "Tree is empty " << std::endl;
+		return false;
+	}
+	std::vector<std::string > data;
+	data.reserve(nodeCount + rowCount);
+	// helper function which walks all the nodes in preorder.
+	helperSerialize(getRoot(), data);
+	return FileIO::getInstance().openFiletoWrite(location + filename, extension, data);
+}
+
+/******************************************************************************/
+/*!
+
+This function reads the tree from a given file. The current content of the tree
+is replaced by the content of the file. A file written by "serializeBinary" is
+mapped and used in place, "verifyChecksum" can be set to false to skip reading
+the coordinates at load time, the nodes are still checked. Any other file is read as the text format. Text
+files holding one point per node, written before the leaves held several
+points, are read back into a balanced tree.
+
+filename - this is the name of the file which contains the saved tree.
+location - this parameter holds the location of the file.  location should always end with "\" or else it will fail to read the file.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::deSerialize(const std::string& filename, const std::string& location, bool verifyChecksum)
+{
+	if (!metricFits())
+		return false;
+	std::shared_ptr<MappedFile> file(new MappedFile);
+	if (!file->open(location + filename))
+	{
+		std::cout << "invalid file name " << location + filename << std::endl;
+		return false;
+	}
+	if (file->size() >= sizeof(FileHeader) && std::memcmp(file->data(), "KDTREEB", 8) == 0)
+	{
+		return loadBinary(file, location + filename, verifyChecksum);
+	}
+	file->close();
+	std::vector<std::string> data = FileIO::getInstance().readFile(location + filename);
+	if (data.size() == 0)
+	{
+		std::cout << "invalid file name " << location + filename << std::endl;
+		return false;
+	}
+	if (data[0].compare(0, 6, "split,") != 0 && data[0].compare(0, 5, "leaf,") != 0)
+	{
+		// files written before the leaves held several points have one point per line in preorder and "nullptr" markers,
+		// their points are rebuilt into a balanced tree
+		std::vector<T> source;
+		for (unsigned int i = 0; i < data.size(); ++i)
+		{
+			if (data[i] == "nullptr")
+				continue;
+			std::vector<T> point = utilities<T>::stringToData(data[i]);
+			point.resize(dimension);
+			source.insert(source.end(), point.begin(), point.end());
+		}
+		clear();
+		return buildFromSource(source);
+	}
+	clear();
+	// every inner node and every leaf takes one line, followed by one line per point for a leaf
+	nodes.reserve(data.size() / 2 + 1);
+	coordinates.reserve(data.size() * dimension);
+	unsigned int  index = 0;
+	root = newNode();
+	if (!reConstructTree(data, index, root))
+	{
+		std::cout << "corrupted tree file " << location + filename << std::endl;
+		clear();
+		return false;
+	}
+	updateViews();
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+This function writes the tree to a binary file. The file holds a header with
+the type, the dimension, the node count and a checksum, followed by the node
+array and the coordinates exactly as they are in memory. It can only be read
+back on a machine with the same byte order.
+
+filename - this is the name of the file, extension included.
+location - location to save the tree data.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::serializeBinary(const std::string& filename, const std::string& location) const
+{
+	if (root == invalidNode)
+	{
+		std::cout << "Tree is empty " << std::endl;
+		return false;
+	}
+	const size_t nodeBytes = nodeCount * sizeof(KDNode);
+	const size_t coordinateBytes = rowCount * dim() * sizeof(T);
+	FileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "KDTREEB", 8);
+	header.version = binaryVersion;
+	header.byteOrder = 0x01020304;
+	header.typeTag = typeTag();
+	header.dimension = dim();
+	header.root = root;
+	header.bucketSize = bucketSize;
+	header.nodeCount = nodeCount;
+	header.rowCount = rowCount;
+	header.nodeOffset = (sizeof(FileHeader) + binaryAlignment - 1) / binaryAlignment * binaryAlignment;
+	header.coordinateOffset = (header.nodeOffset + nodeBytes + binaryAlignment - 1) / binaryAlignment * binaryAlignment;
+	const char* nodeData = reinterpret_cast<const char*>(nodeView);
+	const char* coordinateData = reinterpret_cast<const char*>(coordinateView);
+	header.checksum = checksum(coordinateData, coordinateBytes, checksum(nodeData, nodeBytes, 0));
+
+	std::vector<char> padding(binaryAlignment, 0);
+	std::vector<std::pair<const char*, size_t> > blocks;
+	blocks.push_back(std::make_pair(reinterpret_cast<const char*>(&header), sizeof(FileHeader)));
+	blocks.push_back(std::make_pair(padding.data(), static_cast<size_t>(header.nodeOffset - sizeof(FileHeader))));
+	blocks.push_back(std::make_pair(nodeData, nodeBytes));
+	blocks.push_back(std::make_pair(padding.data(), static_cast<size_t>(header.coordinateOffset - header.nodeOffset - nodeBytes)));
+	blocks.push_back(std::make_pair(coordinateData, coordinateBytes));
+	return FileIO::getInstance().writeBinaryFile(location + filename, blocks);
+}
+
+/******************************************************************************/
+/*!
+
+Checks the header of a mapped binary file and points the tree to its arrays.
+The file is rejected if it was written for another type, dimension, version or
+byte order, if its arrays do not fit in it, if its nodes do not form a tree
+or if the checksum does not match. The nodes are checked even when the
+checksum is not verified.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::loadBinary(const std::shared_ptr<MappedFile>& file, const std::string& filename, bool verifyChecksum)
+{
+	FileHeader header;
+	std::memcpy(&header, file->data(), sizeof(FileHeader));
+	if (header.version != binaryVersion || header.byteOrder != 0x01020304 || header.typeTag != typeTag() || header.dimension != dim())
+	{
+		std::cout << "incompatible tree file " << filename << std::endl;
+		return false;
+	}
+	const std::uint64_t fileSize = file->size();
+	const std::uint64_t nodeBytes = header.nodeCount * sizeof(KDNode);
+	const std::uint64_t coordinateBytes = header.rowCount * dim() * sizeof(T);
+	bool valid = header.nodeCount < invalidNode && header.rowCount < invalidNode && header.bucketSize != 0
+		&& (header.nodeCount == 0 ? header.root == invalidNode : header.root < header.nodeCount)
+		&& header.nodeOffset % alignof(KDNode) == 0 && header.coordinateOffset % alignof(T) == 0
+		&& header.nodeOffset <= fileSize && nodeBytes <= fileSize - header.nodeOffset
+		&& header.coordinateOffset <= fileSize && coordinateBytes <= fileSize - header.coordinateOffset;
+	if (!valid)
+	{
+		std::cout << "corrupted tree file " << filename << std::endl;
+		return false;
+	}
+	const char* nodeData = file->data() + header.nodeOffset;
+	const char* coordinateData = file->data() + header.coordinateOffset;
+	if (!validNodes(reinterpret_cast<const KDNode*>(nodeData), header))
+	{
+		std::cout << "corrupted tree file " << filename << std::endl;
+		return false;
+	}
+	if (verifyChecksum && checksum(coordinateData, static_cast<size_t>(coordinateBytes), checksum(nodeData, static_cast<size_t>(nodeBytes), 0)) != header.checksum)
+	{
+		std::cout << "checksum mismatch in tree file " << filename << std::endl;
+		return false;
+	}
+	clear();
+	mapping = file;
+	nodeView = reinterpret_cast<const KDNode*>(nodeData);
+	coordinateView = reinterpret_cast<const T*>(coordinateData);
+	nodeCount = static_cast<size_t>(header.nodeCount);
+	rowCount = static_cast<size_t>(header.rowCount);
+	bucketSize = header.bucketSize;
+	root = header.root;
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Walks the nodes of a binary file from its root, the way the searches will,
+and checks that every inner node has an axis below the dimension and two
+children in the node array, that every leaf holds rows of the coordinate array
+and that no node is reached twice, so that a damaged file cannot send a search
+out of the arrays or around a cycle. Nodes freed by the removals are not
+reached and keep whatever they held. This takes one pass over the nodes.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::validNodes(const KDNode* fileNodes, const FileHeader& header) const
+{
+	if (header.nodeCount == 0)
+		return true;
+	std::vector<bool> reached(static_cast<size_t>(header.nodeCount), false);
+	TraversalStack<unsigned int, stackCapacity> pending;
+	pending.push(header.root);
+	while (!pending.empty())
+	{
+		const unsigned int next = pending.pop();
+		if (next >= header.nodeCount || reached[next])
+			return false;
+		reached[next] = true;
+		const KDNode& current = fileNodes[next];
+		if (current.axis == leafAxis)
+		{
+			if (static_cast<std::uint64_t>(current.begin) + current.count > header.rowCount)
+				return false;
+		}
+		else
+		{
+			if (current.axis >= dim())
+				return false;
+			pending.push(current.right);
+			pending.push(current.left);
+		}
+	}
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Identifies T in a binary file: its size and whether it is a floating point, a
+signed or an unsigned type.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+std::uint32_t KDTree<T, Dim, Metric>::typeTag()
+{
+	std::uint32_t kind = std::is_floating_point<T>::value ? 2 : (std::is_signed<T>::value ? 1 : 0);
+	return (kind << 8) | static_cast<std::uint32_t>(sizeof(T));
+}
+
+/******************************************************************************/
+/*!
+
+Computes a 64 bit checksum of a block of bytes, 8 bytes at a time. "seed" is
+the checksum of the previous block, which lets several blocks be chained.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+std::uint64_t KDTree<T, Dim, Metric>::checksum(const char* data, size_t size, std::uint64_t seed)
+{
+	const std::uint64_t prime = 0x100000001B3ULL;
+	std::uint64_t hash = seed ^ 0xCBF29CE484222325ULL;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		std::uint64_t word;
+		std::memcpy(&word, data + i, 8);
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 32;
+	}
+	for (; i < size; ++i)
+	{
+		hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+	}
+	return hash ^ size;
+}
+
+/******************************************************************************/
+/*!
+
+This file constructs a KDTree using the data from the file. The file is parsed
+straight into one coordinate buffer, on "threadCount" threads for large files,
+and every line must hold exactly "dimension" values.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::buildfromFile(const std::string& fileName, const std::string& location, unsigned int threadCount)
+{
+	std::vector<T> source;
+	CSVReader<T> reader(dim());
+	if (!reader.readFile(location + fileName, source, threadCount) || source.size() == 0)
+	{
+		std::cout << "invalid file name " << location + fileName <<  std::endl;
+		return false;
+	}
+	return buildFromSource(source);
+}
+
+/******************************************************************************/
+/*!
+
+This builds a balanced KDTree from an in-memory list of points. Points already
+present in the tree are kept and the whole tree is rebuilt using median splits,
+so the shape no longer depends on the order of the input. Returns false if any
+point has fewer coordinates than the dimension of the tree.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::build(const std::vector<Point>& points)
+{
+	for (unsigned int i = 0; i < points.size(); ++i)
+	{
+		if (points[i].size() < dimension)
+		{
+			std::cout << "invalid point at index " << i << ", expected " << dimension << " values" << std::endl;
+			return false;
+		}
+	}
+	std::vector<T> source;
+	source.reserve(points.size() * dimension);
+	for (unsigned int i = 0; i < points.size(); ++i)
+	{
+		source.insert(source.end(), points[i].begin(), points[i].begin() + dimension);
+	}
+	return buildFromSource(source);
+}
+
+/******************************************************************************/
+/*!
+
+Same as above for "pointCount" points stored row by row in one buffer.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::build(const T* points, size_t pointCount)
+{
+	std::vector<T> source(points, points + pointCount * dim());
+	return buildFromSource(source);
+}
+
+/******************************************************************************/
+/*!
+
+Rebuilds the tree from the points of "source", stored row by row, and the
+points already in the tree. "source" is used as scratch space.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::buildFromSource(std::vector<T>& source)
+{
+	if (!metricFits())
+		return false;
+	// the points already in the tree take part in the rebuild
+	ensureOwned();
+	if (garbageRows != 0)
+		compact();
+	source.insert(source.end(), coordinates.begin(), coordinates.end());
+	std::vector<unsigned int> rows(source.size() / dim());
+	for (unsigned int i = 0; i < rows.size(); ++i)
+	{
+		rows[i] = i;
+	}
+	return constructKDTree(source, rows);
+}
+
+/******************************************************************************/
+/*!
+
+This creates a file given by the user which contains a list of all the closest neighbor queried in the input file.
+queryFilename       -  this is the name of the file which holds the list of data whose nearest neighbor we have to find.
+destinationFileName - this is the name of the file which will be used to save all the nearest neighbor.
+
+The file is streamed through three stages running at the same time: a thread
+reads chunks of "chunkSize" queries, the calling thread searches them on
+"threadCount" threads and another thread writes the results through a buffered
+writer. Only "queryChunkCount" chunks exist and they are handed back to the
+reader once written, so a stage running ahead waits for the slower ones and the
+memory used does not depend on the size of the query file.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::kNearestNeighbor(const std::string& queryFileName, const std::string& destinationFileName, const std::string& ext, unsigned int threadCount, size_t chunkSize) const
+{
+	if (root == invalidNode)
+	{
+		std::cout << "Tree is empty " << std::endl;
+		return false;
+	}
+	if (chunkSize == 0)
+		chunkSize = 1;
+	CSVReader<T> reader(dim());
+	std::vector<QueryChunk> chunks(queryChunkCount);
+	chunks[0].count = reader.open(queryFileName) ? reader.read(chunks[0].queries, chunkSize) : 0;
+	if (chunks[0].count == 0)
+	{
+		std::cout << "invalid file name " << queryFileName << std::endl;
+		return false;
+	}
+	BufferedWriter writer;
+	if (!writer.open(destinationFileName + ext))
+	{
+		return false;
+	}
+	BoundedQueue<QueryChunk*> freeChunks(queryChunkCount);
+	BoundedQueue<QueryChunk*> searchQueue(queryChunkCount);
+	BoundedQueue<QueryChunk*> writeQueue(queryChunkCount);
+	for (size_t i = 1; i < chunks.size(); ++i)
+	{
+		freeChunks.push(&chunks[i]);
+	}
+	searchQueue.push(&chunks[0]);
+	std::thread readStage([&reader, &freeChunks, &searchQueue, chunkSize]()
+	{
+		QueryChunk* chunk;
+		while (!reader.done() && freeChunks.pop(chunk))
+		{
+			chunk->queries.clear();
+			chunk->count = reader.read(chunk->queries, chunkSize);
+			if (chunk->count == 0)
+				break;
+			searchQueue.push(chunk);
+		}
+		searchQueue.close();
+	});
+	std::thread writeStage([&writer, &freeChunks, &writeQueue]()
+	{
+		QueryChunk* chunk;
+		while (writeQueue.pop(chunk))
+		{
+			for (size_t i = 0; i < chunk->count; ++i)
+			{
+				writer.write(chunk->lines[i]);
+				writer.put('\n');
+			}
+			freeChunks.push(chunk);
+		}
+	});
+	ThreadPool pool(threadCount);
+	const size_t stride = dim();
+	const size_t grain = 256;
+	QueryChunk* chunk;
+	while (searchQueue.pop(chunk))
+	{
+		chunk->closest.resize(chunk->count);
+		knnBatch(chunk->queries.data(), chunk->count, 1, chunk->closest.data(), pool);
+		chunk->lines.resize(chunk->count);
+		std::vector<std::string>& result = chunk->lines;
+		const std::vector<Neighbor>& closest = chunk->closest;
+		pool.parallelFor(chunk->count, grain, [&result, &closest, stride](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				const T* closestPoint = closest[i].point;
+				std::string sClosestNode = utilities<T>::dataTostring(std::vector<T>(closestPoint, closestPoint + stride));
+				std::string proximityStr = utilities<T>::dataTostring(closest[i].distance);
+				result[i] = sClosestNode + "," + " " + "," + proximityStr;
+			}
+		});
+		writeQueue.push(chunk);
+	}
+	writeQueue.close();
+	writeStage.join();
+	readStage.join();
+	bool written = writer.close();
+	return written && !reader.failed();
+}
+
+/******************************************************************************/
+/*!
+
+Helper function to construct tree. "source" holds the points row by row and
+"rows" lists the rows to use. The tree replaces the current content and the
+points are copied to "coordinates" leaf after leaf in preorder, so a subtree
+occupies a contiguous block of memory. The build runs in O(n log n).
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::constructKDTree(const std::vector<T>& source, std::vector<unsigned int>& rows)
+{
+	// rebuilding a tree writes over the arrays of the previous one instead of allocating new ones
+	reset();
+	if (rows.empty())
+	{
+		return true;
+	}
+	// leaves hold at least half a bucket, there are about twice as many nodes as leaves
+	nodes.reserve(rows.size() / (bucketSize / 2 + 1) * 2 + 1);
+	coordinates.resize(rows.size() * dimension);
+	unsigned int axis = 0;
+	unsigned int nextRow = 0;
+	root = newNode();
+	constructKDTree(source, rows.begin(), rows.end(), axis, root, nextRow);
+	updateViews();
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Turns "currNode" into the subtree holding the rows in [first, last). Up to
+"bucketSize" rows make a leaf, their points are copied to "coordinates" from
+row "nextRow" on. More rows are split by "splitRows", along the dimension
+"axis" and at the median with the default rule, which keeps the tree balanced.
+The subtrees left to build wait on a stack, left ones first, so the leaves get
+their rows in order.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::constructKDTree(const std::vector<T>& source, std::vector<unsigned int>::iterator first, std::vector<unsigned int>::iterator last, unsigned axis, unsigned int currNode, unsigned int& nextRow)
+{
+	const unsigned int stride = dim();
+	TraversalStack<PendingBuild, stackCapacity> pending;
+	PendingBuild start = { first, last, axis, currNode };
+	pending.push(start);
+	while (!pending.empty())
+	{
+		PendingBuild next = pending.pop();
+		const unsigned int count = static_cast<unsigned int>(next.last - next.first);
+		if (count <= bucketSize)
+		{
+			nodes[next.node].axis = leafAxis;
+			nodes[next.node].size = count;
+			nodes[next.node].begin = nextRow;
+			nodes[next.node].count = count;
+			for (; next.first != next.last; ++next.first, ++nextRow)
+			{
+				const T* row = &source[static_cast<size_t>(*next.first) * stride];
+				std::copy(row, row + stride, coordinates.begin() + static_cast<size_t>(nextRow) * stride);
+			}
+			continue;
+		}
+		T split;
+		std::vector<unsigned int>::iterator median = splitRows(source, next.first, next.last, next.axis, split);
+		unsigned int left = newNode();
+		unsigned int right = newNode();
+		// the node array may not be referenced across the calls above as it can grow
+		nodes[next.node].axis = next.axis;
+		nodes[next.node].size = count;
+		nodes[next.node].split = split;
+		nodes[next.node].left = left;
+		nodes[next.node].right = right;
+		PendingBuild rightBuild = { median, next.last, nextAxis(next.axis), right };
+		PendingBuild leftBuild = { next.first, median, nextAxis(next.axis), left };
+		pending.push(rightBuild);
+		pending.push(leftBuild);
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Splits the rows in [first, last), at least 2 of them, according to the split
+rule. The rows are rearranged so that the ones going to the left come before
+the returned position: their value along "axis" is at most "split", and the
+value of the others at least "split", the same way "insertNewNode" sends equal
+values to the left. "axis" is the dimension chosen by the cycle rule on input
+and the dimension chosen on output.
+
+The adaptive rules look at the lowest and highest value, or the variance, of
+every dimension over the rows, which costs a pass over the rows per dimension
+on top of the partial sort of the median. A sliding midpoint leaving more than
+midpointPercent of the rows on one side is moved toward the median until it
+leaves exactly that many, so that clustered points do not make a tree that
+the rebuilds would find out of balance right away.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+std::vector<unsigned int>::iterator KDTree<T, Dim, Metric>::splitRows(const std::vector<T>& source, std::vector<unsigned int>::iterator first, std::vector<unsigned int>::iterator last, unsigned int& axis, T& split) const
+{
+	const size_t stride = dim();
+	const size_t count = static_cast<size_t>(last - first);
+	std::vector<unsigned int>::iterator median = first + count / 2;
+	if (splitRule != SPLIT_CYCLE)
+	{
+		double best = -1.0;
+		T lowest = T();
+		T highest = T();
+		for (unsigned int a = 0; a < stride; ++a)
+		{
+			T low = source[static_cast<size_t>(*first) * stride + a];
+			T high = low;
+			double sum = 0.0;
+			for (std::vector<unsigned int>::iterator row = first; row != last; ++row)
+			{
+				const T value = source[static_cast<size_t>(*row) * stride + a];
+				low = std::min(low, value);
+				high = std::max(high, value);
+				sum += static_cast<double>(value);
+			}
+			double score = static_cast<double>(high) - static_cast<double>(low);
+			if (splitRule == SPLIT_VARIANCE)
+			{
+				// the sum of the squared deviations ranks the dimensions as the variance does
+				const double mean = sum / static_cast<double>(count);
+				score = 0.0;
+				for (std::vector<unsigned int>::iterator row = first; row != last; ++row)
+				{
+					const double deviation = static_cast<double>(source[static_cast<size_t>(*row) * stride + a]) - mean;
+					score += deviation * deviation;
+				}
+			}
+			if (score > best)
+			{
+				best = score;
+				axis = a;
+				lowest = low;
+				highest = high;
+			}
+		}
+		if (splitRule == SPLIT_SLIDING_MIDPOINT && lowest < highest)
+		{
+			const unsigned int index = axis;
+			// halfway is computed in double so that integer and large values do not overflow, it is below "highest" so both sides get rows
+			const T middle = std::min(static_cast<T>(static_cast<double>(lowest) + (static_cast<double>(highest) - static_cast<double>(lowest)) / 2.0), highest);
+			std::vector<unsigned int>::iterator bound = std::partition(first, last, [&source, stride, index, middle](unsigned int row)
+			{
+				return source[static_cast<size_t>(row) * stride + index] <= middle;
+			});
+			const size_t largest = std::max<size_t>(1, count * midpointPercent / 100);
+			const size_t leftCount = static_cast<size_t>(bound - first);
+			if (leftCount != count && leftCount <= largest && count - leftCount <= largest)
+			{
+				split = middle;
+				return bound;
+			}
+			median = first + (leftCount > largest ? largest : count - largest);
+		}
+	}
+	const unsigned int index = axis;
+	// nth_element only does a partial sort, so every level costs linear time
+	std::nth_element(first, median, last, [&source, stride, index](unsigned int lhs, unsigned int rhs)
+	{
+		return source[static_cast<size_t>(lhs) * stride + index] < source[static_cast<size_t>(rhs) * stride + index];
+	});
+	split = source[static_cast<size_t>(*median) * stride + index];
+	return median;
+}
+
+/******************************************************************************/
+/*!
+
+Creates a new empty leaf and returns its index. A node freed by a rebuild is
+reused if there is one, otherwise the node is added at the end of the array.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+unsigned int KDTree<T, Dim, Metric>::newNode()
+{
+	KDNode created;
+	// the padding is cleared too, the node array is written to binary files as it is
+	std::memset(&created, 0, sizeof(KDNode));
+	created.axis = leafAxis;
+	if (!freeNodes.empty())
+	{
+		unsigned int reused = freeNodes.back();
+		freeNodes.pop_back();
+		nodes[reused] = created;
+		return reused;
+	}
+	nodes.push_back(created);
+	updateViews();
+	return static_cast<unsigned int>(nodes.size() - 1);
+}
+
+/******************************************************************************/
+/*!
+
+This function adds a point to a leaf. The points of a leaf must stay
+contiguous, so a leaf followed by the rows of another one is first moved to
+the end of "coordinates" where it can grow. A leaf holding more than
+"bucketSize" points is split along "axis".
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::insert(unsigned int leaf, const T* newData, unsigned axis)
+{
+	const size_t stride = dim();
+	const size_t begin = nodes[leaf].begin;
+	const size_t count = nodes[leaf].count;
+	if ((begin + count) * stride != coordinates.size())
+	{
+		const size_t last = coordinates.size();
+		coordinates.resize(last + count * stride);
+		std::copy(coordinates.begin() + begin * stride, coordinates.begin() + (begin + count) * stride, coordinates.begin() + last);
+		nodes[leaf].begin = static_cast<unsigned int>(last / stride);
+		garbageRows += count;
+	}
+	coordinates.insert(coordinates.end(), newData, newData + stride);
+	++nodes[leaf].count;
+	++nodes[leaf].size;
+	if (nodes[leaf].count > bucketSize)
+	{
+		splitLeaf(leaf, axis);
+	}
+	updateViews();
+	// the rows left behind are reclaimed once they outnumber the points, which keeps the moves amortized
+	if (garbageRows > rowCount / 2)
+	{
+		compact();
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Splits a full leaf along "axis". Its points are rearranged in place so that
+each of the two new leaves holds a contiguous half of them.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::splitLeaf(unsigned int leaf, unsigned axis)
+{
+	const size_t stride = dim();
+	unsigned int nextRow = nodes[leaf].begin;
+	const unsigned int count = nodes[leaf].count;
+	std::vector<T>& source = scratchPoints;
+	std::vector<unsigned int>& rows = scratchRows;
+	source.assign(coordinates.begin() + nextRow * stride, coordinates.begin() + (nextRow + count) * stride);
+	rows.resize(count);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		rows[i] = i;
+	}
+	constructKDTree(source, rows.begin(), rows.end(), axis, leaf, nextRow);
+}
+
+/******************************************************************************/
+/*!
+
+Tells whether a subtree of "size" points whose larger child holds "larger" of
+them has to be rebuilt: it is out of balance, or small enough to be merged
+into one leaf. A leaf splits past "bucketSize" points and merges back below
+half of it, so a subtree around the limit does not keep switching.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+inline bool KDTree<T, Dim, Metric>::unbalanced(unsigned int size, unsigned int larger) const
+{
+	return size <= bucketSize / 2 || static_cast<std::uint64_t>(larger) * 100 > static_cast<std::uint64_t>(size) * balancePercent;
+}
+
+/******************************************************************************/
+/*!
+
+Rebuilds the subtree of "currNode" as a balanced subtree holding its points
+and "newData" if it is not null. Its nodes are reused and its points are
+written at the end of "coordinates". A subtree of n points only goes out of
+balance after a number of insertions or removals proportional to n, so the
+rebuilds cost O(log n) amortized per update.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::rebuild(unsigned int currNode, const T* newData)
+{
+	const size_t stride = dim();
+	std::vector<T>& source = scratchPoints;
+	std::vector<unsigned int>& rows = scratchRows;
+	source.clear();
+	source.reserve((static_cast<size_t>(nodes[currNode].size) + 1) * stride);
+	unsigned int axis = nodes[currNode].axis;
+	collect(currNode, source);
+	if (newData != nullptr)
+	{
+		source.insert(source.end(), newData, newData + stride);
+	}
+	rows.resize(source.size() / stride);
+	for (unsigned int i = 0; i < rows.size(); ++i)
+	{
+		rows[i] = i;
+	}
+	unsigned int nextRow = static_cast<unsigned int>(coordinates.size() / stride);
+	coordinates.resize(coordinates.size() + source.size());
+	constructKDTree(source, rows.begin(), rows.end(), axis, currNode, nextRow);
+	updateViews();
+	releaseScratch();
+	if (garbageRows > rowCount / 2)
+	{
+		compact();
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Appends the points of the subtree of "currNode" to "source". The rows they
+leave become garbage and the nodes below "currNode" are freed.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::collect(unsigned int currNode, std::vector<T>& source)
+{
+	const size_t stride = dim();
+	TraversalStack<unsigned int, stackCapacity> pending;
+	pending.push(currNode);
+	while (!pending.empty())
+	{
+		unsigned int next = pending.pop();
+		KDNode& curr = nodes[next];
+		if (curr.axis == leafAxis)
+		{
+			const size_t begin = curr.begin;
+			source.insert(source.end(), coordinates.begin() + begin * stride, coordinates.begin() + (begin + curr.count) * stride);
+			garbageRows += curr.count;
+			curr.count = 0;
+		}
+		else
+		{
+			pending.push(curr.right);
+			pending.push(curr.left);
+		}
+		if (next != currNode)
+		{
+			// a freed node is marked as inner so that "compact" does not take it for a leaf
+			curr.axis = 0;
+			freeNodes.push_back(next);
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Looks for a point equal to "data" in the subtree of "currNode". Points equal to
+a split may be on both sides of it, so both are searched. On success "path"
+holds the nodes from "currNode" down to the leaf and "row" the row of the
+point. Each pending node carries its depth, which tells how much of "path"
+belongs to its ancestors.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::locate(unsigned int currNode, const T* data, std::vector<unsigned int>& path, unsigned int& row) const
+{
+	const size_t base = path.size();
+	TraversalStack<PendingDepth, stackCapacity> pending;
+	PendingDepth start = { currNode, 0 };
+	pending.push(start);
+	while (!pending.empty())
+	{
+		PendingDepth next = pending.pop();
+		path.resize(base + next.depth);
+		path.push_back(next.node);
+		const KDNode& curr = node(next.node);
+		if (curr.axis == leafAxis)
+		{
+			const T* currData = point(curr.begin);
+			for (unsigned int i = 0; i < curr.count; ++i, currData += dim())
+			{
+				if (std::equal(data, data + dim(), currData))
+				{
+					row = curr.begin + i;
+					return true;
+				}
+			}
+			continue;
+		}
+		PendingDepth right = { curr.right, next.depth + 1 };
+		PendingDepth left = { curr.left, next.depth + 1 };
+		if (data[curr.axis] >= curr.split)
+			pending.push(right);
+		if (data[curr.axis] <= curr.split)
+			pending.push(left);
+	}
+	path.resize(base);
+	return false;
+}
+
+/******************************************************************************/
+/*!
+
+Packs the points of the leaves at the start of "coordinates", dropping the
+rows left behind by leaves moved to grow.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::compact()
+{
+	const size_t stride = dim();
+	std::vector<T> packed;
+	packed.reserve((rowCount - garbageRows) * stride);
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (nodes[i].axis != leafAxis)
+			continue;
+		const size_t begin = nodes[i].begin;
+		nodes[i].begin = static_cast<unsigned int>(packed.size() / stride);
+		packed.insert(packed.end(), coordinates.begin() + begin * stride, coordinates.begin() + (begin + nodes[i].count) * stride);
+	}
+	coordinates.swap(packed);
+	garbageRows = 0;
+	updateViews();
+}
+
+/******************************************************************************/
+/*!
+
+Releases the work buffers once a rebuild of a large subtree made them grow past
+"scratchLimit". The small rebuilds and leaf splits, which are most of them,
+keep reusing the same buffers.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::releaseScratch()
+{
+	if (scratchPoints.capacity() > scratchLimit)
+	{
+		std::vector<T>().swap(scratchPoints);
+	}
+	if (scratchRows.capacity() > scratchLimit)
+	{
+		std::vector<unsigned int>().swap(scratchRows);
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Used to destroy the tree. Both arrays are released in one go, a mapped file is
+unmapped once no other tree uses it.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::clear( )
+{
+	std::vector<KDNode>().swap(nodes);
+	std::vector<T>().swap(coordinates);
+	std::vector<unsigned int>().swap(freeNodes);
+	std::vector<T>().swap(scratchPoints);
+	std::vector<unsigned int>().swap(scratchRows);
+	std::vector<unsigned int>().swap(scratchPath);
+	lowPrecision.clear();
+	garbageRows = 0;
+	mapping.reset();
+	updateViews();
+	root = invalidNode;
+}
+
+/******************************************************************************/
+/*!
+
+Empties the tree like "clear" but keeps its arrays allocated. A tree that is
+emptied and built again, or refilled by insertions, then writes over the
+memory of the previous one instead of freeing it and allocating it again.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::reset()
+{
+	nodes.clear();
+	coordinates.clear();
+	freeNodes.clear();
+	lowPrecision.clear();
+	garbageRows = 0;
+	mapping.reset();
+	updateViews();
+	root = invalidNode;
+}
+
+/******************************************************************************/
+/*!
+
+Allocates room for "pointCount" points and the nodes holding them, so that
+inserting up to that many points does not reallocate the arrays. A mapped tree
+is copied to memory first.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::reserve(size_t pointCount)
+{
+	ensureOwned();
+	coordinates.reserve(pointCount * dim());
+	// leaves filled by insertions hold at least half a bucket
+	nodes.reserve(pointCount / (bucketSize / 2 + 1) * 2 + 1);
+	updateViews();
+}
+
+/******************************************************************************/
+/*!
+
+Reorders the node array in the given layout and the rows of the points in the
+order of the leaves, left to right. Nodes freed by rebuilds and rows left unused
+are dropped on the way. A mapped tree is copied to memory first, and the low
+precision copy is made again in the new order of the points. Insertions append
+their nodes and rows at the end, so a tree updated a lot can be laid out again.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::relayout(NodeLayout layout)
+{
+	if (root == invalidNode)
+	{
+		return;
+	}
+	ensureOwned();
+	std::vector<unsigned int> order;
+	order.reserve(nodes.size() - freeNodes.size());
+	layoutOrder(layout, order);
+	std::vector<unsigned int> position(nodes.size(), static_cast<unsigned int>(invalidNode));
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		position[order[i]] = static_cast<unsigned int>(i);
+	}
+	std::vector<KDNode> laidOut(order.size());
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		laidOut[i] = nodes[order[i]];
+		if (laidOut[i].axis != leafAxis)
+		{
+			laidOut[i].left = position[laidOut[i].left];
+			laidOut[i].right = position[laidOut[i].right];
+		}
+	}
+	// the rows follow the leaves from left to right, a depth first walk of the tree
+	const size_t stride = dim();
+	std::vector<T> packed;
+	packed.reserve(static_cast<size_t>(nodes[root].size) * stride);
+	TraversalStack<unsigned int, stackCapacity> pending;
+	pending.push(root);
+	while (!pending.empty())
+	{
+		const unsigned int next = pending.pop();
+		const KDNode& curr = nodes[next];
+		if (curr.axis != leafAxis)
+		{
+			pending.push(curr.right);
+			pending.push(curr.left);
+			continue;
+		}
+		laidOut[position[next]].begin = static_cast<unsigned int>(packed.size() / stride);
+		packed.insert(packed.end(), coordinates.begin() + static_cast<size_t>(curr.begin) * stride, coordinates.begin() + static_cast<size_t>(curr.begin + curr.count) * stride);
+	}
+	nodes.swap(laidOut);
+	coordinates.swap(packed);
+	root = 0;
+	std::vector<unsigned int>().swap(freeNodes);
+	garbageRows = 0;
+	updateViews();
+	if (!lowPrecision.empty())
+	{
+		lowPrecision.encode(coordinateView, rowCount, dim(), lowPrecision.precision());
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Helper function of "relayout". Lists the nodes of the tree in the given layout,
+the root first.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::layoutOrder(NodeLayout layout, std::vector<unsigned int>& order) const
+{
+	if (layout == LAYOUT_VAN_EMDE_BOAS)
+	{
+		unsigned int height = 0;
+		TraversalStack<PendingDepth, stackCapacity> pending;
+		PendingDepth start = { root, 0 };
+		pending.push(start);
+		while (!pending.empty())
+		{
+			PendingDepth next = pending.pop();
+			const KDNode& curr = node(next.node);
+			height = std::max(height, next.depth);
+			if (curr.axis == leafAxis)
+				continue;
+			PendingDepth right = { curr.right, next.depth + 1 };
+			PendingDepth left = { curr.left, next.depth + 1 };
+			pending.push(right);
+			pending.push(left);
+		}
+		vanEmdeBoasOrder(root, height + 1, order);
+		return;
+	}
+	if (layout == LAYOUT_BLOCKED)
+	{
+		// the most levels of a complete subtree fitting in a block
+		unsigned int blockLevels = 1;
+		while (((static_cast<size_t>(2) << blockLevels) - 1) * sizeof(KDNode) <= layoutBlockBytes)
+		{
+			++blockLevels;
+		}
+		std::vector<unsigned int> level;
+		std::vector<unsigned int> nextLevel;
+		TraversalStack<unsigned int, stackCapacity> blocks;
+		blocks.push(root);
+		while (!blocks.empty())
+		{
+			level.assign(1, blocks.pop());
+			for (unsigned int depth = 0; depth < blockLevels && !level.empty(); ++depth)
+			{
+				nextLevel.clear();
+				for (size_t i = 0; i < level.size(); ++i)
+				{
+					order.push_back(level[i]);
+					const KDNode& curr = node(level[i]);
+					if (curr.axis == leafAxis)
+						continue;
+					nextLevel.push_back(curr.left);
+					nextLevel.push_back(curr.right);
+				}
+				level.swap(nextLevel);
+			}
+			// the subtrees hanging below the block start blocks of their own, the leftmost first
+			for (size_t i = level.size(); i-- > 0;)
+			{
+				blocks.push(level[i]);
+			}
+		}
+		return;
+	}
+	TraversalStack<unsigned int, stackCapacity> pending;
+	pending.push(root);
+	while (!pending.empty())
+	{
+		unsigned int next = pending.pop();
+		order.push_back(next);
+		const KDNode& curr = node(next);
+		if (curr.axis == leafAxis)
+			continue;
+		pending.push(curr.right);
+		pending.push(curr.left);
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Helper function of "relayout". Lists the nodes of the subtree of "top" that are
+less than "levels" levels below it in van Emde Boas order: the upper half of the
+levels, laid out the same way, then each subtree hanging below it from left to
+right. The levels halve with each call, so it recurses at most log2 of the
+height of the tree deep.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::vanEmdeBoasOrder(unsigned int top, unsigned int levels, std::vector<unsigned int>& order) const
+{
+	if (levels == 1 || node(top).axis == leafAxis)
+	{
+		order.push_back(top);
+		return;
+	}
+	const unsigned int upper = levels / 2;
+	vanEmdeBoasOrder(top, upper, order);
+	// the roots of the lower subtrees are the nodes "upper" levels below "top", leaves above them are in the upper half
+	std::vector<unsigned int> bottoms(1, top);
+	std::vector<unsigned int> next;
+	for (unsigned int depth = 0; depth < upper && !bottoms.empty(); ++depth)
+	{
+		next.clear();
+		for (size_t i = 0; i < bottoms.size(); ++i)
+		{
+			const KDNode& curr = node(bottoms[i]);
+			if (curr.axis == leafAxis)
+				continue;
+			next.push_back(curr.left);
+			next.push_back(curr.right);
+		}
+		bottoms.swap(next);
+	}
+	for (size_t i = 0; i < bottoms.size(); ++i)
+	{
+		vanEmdeBoasOrder(bottoms[i], levels - upper, order);
+	}
+}
+
+/******************************************************************************/
+/*!
+
+This function is a helper function to serialize the tree to a file.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void KDTree<T, Dim, Metric>::helperSerialize(unsigned int curr, std::vector<std::string>& vecdata) const
+{
+	TraversalStack<unsigned int, stackCapacity> pending;
+	pending.push(curr);
+	while (!pending.empty())
+	{
+		const KDNode& currNode = node(pending.pop());
+		if (currNode.axis == leafAxis)
+		{
+			// a leaf is written as its point count followed by one line per point
+			vecdata.push_back("leaf," + std::to_string(currNode.count));
+			const T* currData = point(currNode.begin);
+			for (unsigned int i = 0; i < currNode.count; ++i, currData += dimension)
+			{
+				vecdata.push_back(utilities<T>::dataTostring(std::vector<T>(currData, currData + dimension)));
+			}
+			continue;
+		}
+		// the split is written with the precision of the points so that it still separates them once read back
+		vecdata.push_back("split," + std::to_string(currNode.axis) + "," + utilities<T>::dataTostring(std::vector<T>(1, currNode.split)));
+		// the nodes are written in preorder, the left subtree before the right one
+		pending.push(currNode.right);
+		pending.push(currNode.left);
+	}
+}
+/******************************************************************************/
+/*!
+
+Helper function to Deserialize a tree. The lines describe the nodes in
+preorder, so the node each line describes is the one on top of a stack of
+nodes waiting for their line: an inner node pushes its right child and then
+its left one. The point counts of the inner nodes are added up once every
+leaf is read. The nodes of a tree being read are all new, so children come
+after their parent in the node array and one backward pass over it is enough.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool KDTree<T, Dim, Metric>::reConstructTree(const std::vector<std::string>& data, unsigned& index, unsigned int currNode)
+{
+	TraversalStack<unsigned int, stackCapacity> pending;
+	pending.push(currNode);
+	while (!pending.empty())
+	{
+		if (index >= data.size())
+		{
+			return false;
+		}
+		unsigned int next = pending.pop();
+		const std::string& line = data[index];
+		++index;
+		if (line.compare(0, 5, "leaf,") == 0)
+		{
+			unsigned long count = std::strtoul(line.c_str() + 5, nullptr, 10);
+			if (count > data.size() - index)
+			{
+				return false;
+			}
+			nodes[next].axis = leafAxis;
+			nodes[next].size = static_cast<unsigned int>(count);
+			nodes[next].begin = static_cast<unsigned int>(coordinates.size() / dimension);
+			nodes[next].count = static_cast<unsigned int>(count);
+			for (unsigned long i = 0; i < count; ++i, ++index)
+			{
+				std::vector<T> point = utilities<T>::stringToData(data[index]);
+				point.resize(dimension);
+				coordinates.insert(coordinates.end(), point.begin(), point.end());
+			}
+			continue;
+		}
+		if (line.compare(0, 6, "split,") != 0)
+		{
+			return false;
+		}
+		char* end = nullptr;
+		unsigned long axis = std::strtoul(line.c_str() + 6, &end, 10);
+		T split = T();
+		if (axis >= dimension || *end != ',' || utilities<T>::parseValue(end + 1, line.c_str() + line.size(), split) == nullptr)
+		{
+			return false;
+		}
+		unsigned int left = newNode();
+		unsigned int right = newNode();
+		nodes[next].axis = static_cast<unsigned int>(axis);
+		nodes[next].split = split;
+		nodes[next].left = left;
+		nodes[next].right = right;
+		pending.push(right);
+		pending.push(left);
+	}
+	for (size_t i = nodes.size(); i-- > currNode;)
+	{
+		if (nodes[i].axis != leafAxis)
+		{
+			nodes[i].size = nodes[nodes[i].left].size + nodes[nodes[i].right].size;
+		}
+	}
+	return true;
 }
@@ -0,0 +1,320 @@
+/******************************************************************************/
+/*!
+\file   LowPrecisionCoordinates.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\class LowPrecisionCoordinates
+\brief
+LowPrecisionCoordinates keeps a copy of points, stored row by row, in fewer
+bytes per value than T. A search scans this copy, which takes 2 to 8 times less
+memory and cache than the points themselves, and only reads the full precision
+points of its final candidates.
+
+Values are stored either as floating point numbers, 32 or 16 bits, or as 16 or
+8 bit integers spread evenly between the lowest and highest value of each axis.
+16 bit floats and integers are taken relative to the bounds of their axis too,
+so that values of any magnitude fit. A decoded value is within half a step of
+the original: (high - low) / 65535 or / 255 for the integers, and a relative
+2^-11 of the range for 16 bit floats.
+
+Operations include:
+
+- encode rows of points at a chosen precision
+- decode one row
+- tell the precision and the memory used
+
+*/
+/******************************************************************************/
+
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <math.h>
+
+//! how a LowPrecisionCoordinates stores each value. PRECISION_FULL stores nothing.
+enum CoordinatePrecision
+{
+	PRECISION_FULL,
+	PRECISION_FLOAT32,
+	PRECISION_FLOAT16,
+	PRECISION_INT16,
+	PRECISION_INT8
+};
+
+template <typename T>
+class LowPrecisionCoordinates
+{
+public:
+	LowPrecisionCoordinates();
+	void encode(const T* rows, size_t rowCount, unsigned int dim, CoordinatePrecision precision);
+	void clear();
+	bool empty() const;
+	void decode(size_t row, T* values) const;
+	CoordinatePrecision precision() const;
+	size_t bytes() const;
+private:
+	static std::uint16_t toHalf(float value);
+	static float fromHalf(std::uint16_t value);
+
+	CoordinatePrecision mode;
+	unsigned int dimension;
+	//! bytes of one row.
+	size_t stride;
+	std::vector<unsigned char> values;
+	//! a value v of axis a is stored as (v - low[a]) / step[a].
+	std::vector<double> low;
+	std::vector<double> step;
+};
+
+
+template <typename T>
+LowPrecisionCoordinates<T>::LowPrecisionCoordinates() : mode(PRECISION_FULL), dimension(0), stride(0)
+{
+}
+
+/******************************************************************************/
+/*!
+
+Encodes "rowCount" rows of "dim" values at the given precision, replacing what
+was stored. PRECISION_FULL clears the copy.
+
+*/
+/******************************************************************************/
+template <typename T>
+void LowPrecisionCoordinates<T>::encode(const T* rows, size_t rowCount, unsigned int dim, CoordinatePrecision precision)
+{
+	clear();
+	if (precision == PRECISION_FULL || rowCount == 0 || dim == 0)
+	{
+		return;
+	}
+	mode = precision;
+	dimension = dim;
+	low.assign(dim, 0.0);
+	step.assign(dim, 1.0);
+	if (precision != PRECISION_FLOAT32)
+	{
+		std::vector<double> high(dim);
+		for (unsigned int i = 0; i < dim; ++i)
+		{
+			low[i] = high[i] = static_cast<double>(rows[i]);
+		}
+		for (size_t row = 1; row < rowCount; ++row)
+		{
+			const T* values = rows + row * dim;
+			for (unsigned int i = 0; i < dim; ++i)
+			{
+				low[i] = std::min(low[i], static_cast<double>(values[i]));
+				high[i] = std::max(high[i], static_cast<double>(values[i]));
+			}
+		}
+		const double levels = precision == PRECISION_INT8 ? 255.0 : precision == PRECISION_INT16 ? 65535.0 : 1.0;
+		for (unsigned int i = 0; i < dim; ++i)
+		{
+			// an axis holding one value keeps a step of 1, every value of it is stored as 0
+			if (high[i] > low[i])
+				step[i] = (high[i] - low[i]) / levels;
+		}
+	}
+	const size_t valueSize = precision == PRECISION_FLOAT32 ? 4 : precision == PRECISION_INT8 ? 1 : 2;
+	stride = valueSize * dim;
+	values.resize(stride * rowCount);
+	for (size_t row = 0; row < rowCount; ++row)
+	{
+		const T* source = rows + row * dim;
+		unsigned char* target = &values[row * stride];
+		for (unsigned int i = 0; i < dim; ++i)
+		{
+			double scaled = (static_cast<double>(source[i]) - low[i]) / step[i];
+			if (precision == PRECISION_FLOAT32)
+			{
+				float stored = static_cast<float>(scaled);
+				std::memcpy(target + i * 4, &stored, 4);
+			}
+			else if (precision == PRECISION_FLOAT16)
+			{
+				std::uint16_t stored = toHalf(static_cast<float>(scaled));
+				std::memcpy(target + i * 2, &stored, 2);
+			}
+			else if (precision == PRECISION_INT16)
+			{
+				std::uint16_t stored = static_cast<std::uint16_t>(std::min(65535.0, std::max(0.0, floor(scaled + 0.5))));
+				std::memcpy(target + i * 2, &stored, 2);
+			}
+			else
+			{
+				target[i] = static_cast<unsigned char>(std::min(255.0, std::max(0.0, floor(scaled + 0.5))));
+			}
+		}
+	}
+}
+
+template <typename T>
+void LowPrecisionCoordinates<T>::clear()
+{
+	mode = PRECISION_FULL;
+	dimension = 0;
+	stride = 0;
+	std::vector<unsigned char>().swap(values);
+	std::vector<double>().swap(low);
+	std::vector<double>().swap(step);
+}
+
+template <typename T>
+bool LowPrecisionCoordinates<T>::empty() const
+{
+	return mode == PRECISION_FULL;
+}
+
+/******************************************************************************/
+/*!
+
+Writes the "dimension" values of a row, back in T, to "result".
+
+*/
+/******************************************************************************/
+template <typename T>
+inline void LowPrecisionCoordinates<T>::decode(size_t row, T* result) const
+{
+	const unsigned char* source = &values[row * stride];
+	const double* lows = low.data();
+	const double* steps = step.data();
+	switch (mode)
+	{
+	case PRECISION_FLOAT32:
+		for (unsigned int i = 0; i < dimension; ++i)
+		{
+			float stored;
+			std::memcpy(&stored, source + i * 4, 4);
+			result[i] = static_cast<T>(stored);
+		}
+		break;
+	case PRECISION_FLOAT16:
+		for (unsigned int i = 0; i < dimension; ++i)
+		{
+			std::uint16_t stored;
+			std::memcpy(&stored, source + i * 2, 2);
+			result[i] = static_cast<T>(lows[i] + fromHalf(stored) * steps[i]);
+		}
+		break;
+	case PRECISION_INT16:
+		for (unsigned int i = 0; i < dimension; ++i)
+		{
+			std::uint16_t stored;
+			std::memcpy(&stored, source + i * 2, 2);
+			result[i] = static_cast<T>(lows[i] + stored * steps[i]);
+		}
+		break;
+	case PRECISION_INT8:
+		for (unsigned int i = 0; i < dimension; ++i)
+		{
+			result[i] = static_cast<T>(lows[i] + source[i] * steps[i]);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+template <typename T>
+CoordinatePrecision LowPrecisionCoordinates<T>::precision() const
+{
+	return mode;
+}
+
+/******************************************************************************/
+/*!
+
+Returns the bytes allocated for the stored values and the bounds of the axes.
+
+*/
+/******************************************************************************/
+template <typename T>
+size_t LowPrecisionCoordinates<T>::bytes() const
+{
+	return values.capacity() + (low.capacity() + step.capacity()) * sizeof(double);
+}
+
+/******************************************************************************/
+/*!
+
+Converts a float to the nearest 16 bit float, ties to even. Values too large
+become infinite and values too small become 0.
+
+*/
+/******************************************************************************/
+template <typename T>
+std::uint16_t LowPrecisionCoordinates<T>::toHalf(float value)
+{
+	std::uint32_t bits;
+	std::memcpy(&bits, &value, 4);
+	const std::uint32_t sign = (bits >> 16) & 0x8000;
+	const int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+	std::uint32_t mantissa = bits & 0x7FFFFF;
+	if (((bits >> 23) & 0xFF) == 0xFF)
+	{
+		return static_cast<std::uint16_t>(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+	}
+	if (exponent >= 31)
+	{
+		return static_cast<std::uint16_t>(sign | 0x7C00);
+	}
+	if (exponent <= 0)
+	{
+		// subnormal 16 bit float, or 0 when even that is too small
+		if (exponent < -10)
+		{
+			return static_cast<std::uint16_t>(sign);
+		}
+		mantissa |= 0x800000;
+		const int shift = 14 - exponent;
+		std::uint32_t half = mantissa >> shift;
+		const std::uint32_t rest = mantissa & ((1u << shift) - 1);
+		const std::uint32_t middle = 1u << (shift - 1);
+		if (rest > middle || (rest == middle && (half & 1) != 0))
+			++half;
+		return static_cast<std::uint16_t>(sign | half);
+	}
+	std::uint32_t half = (static_cast<std::uint32_t>(exponent) << 10) | (mantissa >> 13);
+	const std::uint32_t rest = mantissa & 0x1FFF;
+	// a carry out of the mantissa correctly moves to the next exponent
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1) != 0))
+		++half;
+	return static_cast<std::uint16_t>(sign | half);
+}
+
+template <typename T>
+inline float LowPrecisionCoordinates<T>::fromHalf(std::uint16_t value)
+{
+	const std::uint32_t sign = static_cast<std::uint32_t>(value & 0x8000) << 16;
+	const std::uint32_t exponent = (value >> 10) & 0x1F;
+	const std::uint32_t mantissa = value & 0x3FF;
+	std::uint32_t bits;
+	if (exponent == 0)
+	{
+		float result = static_cast<float>(ldexp(static_cast<double>(mantissa), -24));
+		return sign != 0 ? -result : result;
+	}
+	if (exponent == 31)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+	float result;
+	std::memcpy(&result, &bits, 4);
+	return result;
+}
@@ -0,0 +1,145 @@
+/******************************************************************************/
+/*!
+\file   MappedFile.cpp
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+#include "MappedFile.h"
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : address(nullptr), length(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+{
+}
+#else
+MappedFile::MappedFile() : address(nullptr), length(0)
+{
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+/******************************************************************************/
+/*!
+
+Maps the file named "filename". Returns false if the file cannot be opened or
+is empty. A file already mapped by this object is unmapped first.
+
+*/
+/******************************************************************************/
+bool MappedFile::open(const std::string& filename)
+{
+	close();
+#ifdef _WIN32
+	fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		std::cout << "Failed to open file" << " " << filename << std::endl;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		std::cout << "Failed to map file" << " " << filename << std::endl;
+		close();
+		return false;
+	}
+	address = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (address == nullptr)
+	{
+		std::cout << "Failed to map file" << " " << filename << std::endl;
+		close();
+		return false;
+	}
+	length = static_cast<size_t>(fileSize.QuadPart);
+#else
+	int descriptor = ::open(filename.c_str(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		std::cout << "Failed to open file" << " " << filename << std::endl;
+		return false;
+	}
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+	{
+		::close(descriptor);
+		return false;
+	}
+	void* mapping = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+	// the mapping keeps the file alive, the descriptor is not needed anymore
+	::close(descriptor);
+	if (mapping == MAP_FAILED)
+	{
+		std::cout << "Failed to map file" << " " << filename << std::endl;
+		return false;
+	}
+	address = static_cast<const char*>(mapping);
+	length = static_cast<size_t>(status.st_size);
+#endif
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Unmaps the file. Pointers into the mapping become invalid.
+
+*/
+/******************************************************************************/
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (address != nullptr)
+		UnmapViewOfFile(address);
+	if (mappingHandle != nullptr)
+		CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (address != nullptr)
+		munmap(const_cast<char*>(address), length);
+#endif
+	address = nullptr;
+	length = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+	return address != nullptr;
+}
+
+const char* MappedFile::data() const
+{
+	return address;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
@@ -0,0 +1,54 @@
+/******************************************************************************/
+/*!
+\file   MappedFile.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\class MappedFile
+\brief
+MappedFile maps a whole file read-only into memory. The pages are loaded by the
+operating system when they are first touched and are shared by every process
+mapping the same file. Following RAII the destructor unmaps the file.
+
+Operations include:
+
+- map a file given the file name
+- access the mapped bytes
+- unmap the file
+
+*/
+/******************************************************************************/
+
+#pragma once
+#include <string>
+#include <cstddef>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	bool open(const std::string& filename);
+	void close();
+	bool isOpen() const;
+	const char* data() const;
+	size_t size() const;
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+	//! first byte of the mapping, nullptr when no file is mapped.
+	const char* address;
+	size_t length;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#endif
+};
@@ -0,0 +1,297 @@
+/******************************************************************************/
+/*!
+\file   Metric.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\brief
+Distance metrics a KDTree can search with, passed as its third template
+argument. Every call is resolved at compile time and inlined in the search.
+
+A metric works with "reduced" distances, which order points the same way as
+the distances but are cheaper to compute: the squared distance for the L2
+metrics, the distance itself for the others. A metric provides:
+
+- distance    - reduced distance between 2 points. "Dim" is the dimension
+                when it is known at compile time, 0 otherwise.
+- axisBound   - lower bound of the reduced distance from the query to any point
+                on the other side of a splitting plane, given the gap between
+                the query and the plane along "axis".
+- updateBound - reduced distance from the query to the cell of a child, given
+                the distance "reduced" to the cell of its parent and the
+                "axisBound" of the gap to the cell along the split axis, which
+                grows from "oldBound" to "newBound". A search skips a cell
+                when its distance is not below its farthest neighbor. The gap
+                never shrinks from parent to child, so "newBound - oldBound"
+                does not wrap around for unsigned types.
+- toReduced and fromReduced - convert between distances and reduced distances.
+- power       - reduced distances scale as the distances to this power, which
+                lets an approximate search scale its bound by (1 + epsilon).
+- fits        - whether the metric can measure points of "dim" dimensions. A
+                tree refuses points while its metric does not fit.
+
+Metrics provided:
+
+- L2Metric         - Eucledian distance, the default.
+- SquaredL2Metric  - squared Eucledian distance. Reported distances and radii
+                     are squared, no square root is ever taken.
+- L1Metric         - Manhattan distance, the sum of the differences.
+- LInfMetric       - Chebyshev distance, the largest difference.
+- WeightedL2Metric - Eucledian distance with a weight per axis.
+
+*/
+/******************************************************************************/
+
+#pragma once
+#include "utilities.h"
+#include <vector>
+#include <math.h>
+
+namespace MetricDetail
+{
+	//! difference between 2 coordinates, computed without wrapping around for unsigned types.
+	template <typename T>
+	inline T absoluteDifference(T a, T b)
+	{
+		return a < b ? b - a : a - b;
+	}
+}
+
+template <typename T>
+struct L2Metric
+{
+	static const unsigned int power = 2;
+
+	template <unsigned int Dim>
+	T distance(const T* p1, const T* p2, unsigned int size) const
+	{
+		if (Dim != 0)
+		{
+			return FixedDistance<T, Dim>::squared(p1, p2);
+		}
+		return utilities<T>::squaredDistance(p1, p2, size);
+	}
+
+	T axisBound(T gap, unsigned int) const
+	{
+		return gap * gap;
+	}
+
+	T updateBound(T reduced, T oldBound, T newBound) const
+	{
+		return reduced + (newBound - oldBound);
+	}
+
+	bool fits(unsigned int) const
+	{
+		return true;
+	}
+
+	T toReduced(T distance) const
+	{
+		return distance * distance;
+	}
+
+	T fromReduced(T reduced) const
+	{
+		return static_cast<T>(sqrt(reduced));
+	}
+};
+
+template <typename T>
+struct SquaredL2Metric
+{
+	static const unsigned int power = 1;
+
+	template <unsigned int Dim>
+	T distance(const T* p1, const T* p2, unsigned int size) const
+	{
+		if (Dim != 0)
+		{
+			return FixedDistance<T, Dim>::squared(p1, p2);
+		}
+		return utilities<T>::squaredDistance(p1, p2, size);
+	}
+
+	T axisBound(T gap, unsigned int) const
+	{
+		return gap * gap;
+	}
+
+	T updateBound(T reduced, T oldBound, T newBound) const
+	{
+		return reduced + (newBound - oldBound);
+	}
+
+	bool fits(unsigned int) const
+	{
+		return true;
+	}
+
+	T toReduced(T distance) const
+	{
+		return distance;
+	}
+
+	T fromReduced(T reduced) const
+	{
+		return reduced;
+	}
+};
+
+template <typename T>
+struct L1Metric
+{
+	static const unsigned int power = 1;
+
+	template <unsigned int Dim>
+	T distance(const T* p1, const T* p2, unsigned int size) const
+	{
+		const unsigned int count = Dim != 0 ? Dim : size;
+		T result = T();
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			result += MetricDetail::absoluteDifference(p1[i], p2[i]);
+		}
+		return result;
+	}
+
+	T axisBound(T gap, unsigned int) const
+	{
+		return gap;
+	}
+
+	T updateBound(T reduced, T oldBound, T newBound) const
+	{
+		return reduced + (newBound - oldBound);
+	}
+
+	bool fits(unsigned int) const
+	{
+		return true;
+	}
+
+	T toReduced(T distance) const
+	{
+		return distance;
+	}
+
+	T fromReduced(T reduced) const
+	{
+		return reduced;
+	}
+};
+
+template <typename T>
+struct LInfMetric
+{
+	static const unsigned int power = 1;
+
+	template <unsigned int Dim>
+	T distance(const T* p1, const T* p2, unsigned int size) const
+	{
+		const unsigned int count = Dim != 0 ? Dim : size;
+		T result = T();
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			result = std::max(result, MetricDetail::absoluteDifference(p1[i], p2[i]));
+		}
+		return result;
+	}
+
+	T axisBound(T gap, unsigned int) const
+	{
+		return gap;
+	}
+
+	T updateBound(T reduced, T, T newBound) const
+	{
+		return std::max(reduced, newBound);
+	}
+
+	bool fits(unsigned int) const
+	{
+		return true;
+	}
+
+	T toReduced(T distance) const
+	{
+		return distance;
+	}
+
+	T fromReduced(T reduced) const
+	{
+		return reduced;
+	}
+};
+
+/******************************************************************************/
+/*!
+\class WeightedL2Metric
+\brief
+Eucledian distance where the difference along axis i counts "weights[i]" times
+in the squared distance. Weights must not be negative and there must be one per
+dimension of the tree. A weight of 0 ignores an axis, which makes a splitting
+plane along it free to cross. There is no default constructor: a metric without
+weights would read past them, so the weights are always given.
+
+*/
+/******************************************************************************/
+template <typename T>
+struct WeightedL2Metric
+{
+	static const unsigned int power = 2;
+
+	WeightedL2Metric(const std::vector<T>& axisWeights) : weights(axisWeights)
+	{
+	}
+
+	template <unsigned int Dim>
+	T distance(const T* p1, const T* p2, unsigned int size) const
+	{
+		const unsigned int count = Dim != 0 ? Dim : size;
+		const T* weight = weights.data();
+		T result = T();
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			T diff = MetricDetail::absoluteDifference(p1[i], p2[i]);
+			result += weight[i] * diff * diff;
+		}
+		return result;
+	}
+
+	T axisBound(T gap, unsigned int axis) const
+	{
+		return weights[axis] * gap * gap;
+	}
+
+	T updateBound(T reduced, T oldBound, T newBound) const
+	{
+		return reduced + (newBound - oldBound);
+	}
+
+	bool fits(unsigned int dim) const
+	{
+		return weights.size() == dim;
+	}
+
+	T toReduced(T distance) const
+	{
+		return distance * distance;
+	}
+
+	T fromReduced(T reduced) const
+	{
+		return static_cast<T>(sqrt(reduced));
+	}
+
+	std::vector<T> weights;
+};
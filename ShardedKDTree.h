@@ -0,0 +1,893 @@
+/******************************************************************************/
+/*!
+\file   ShardedKDTree.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\class ShardedKDTree
+\brief
+ShardedKDTree splits a set of points into a forest of independent KDTrees, the
+shards. The points are cut by a few top level splits, each at the median of the
+most spread out dimension of its points, so every shard covers a box of space
+and holds about the same number of points. The shards are then built, saved
+and loaded on several threads at once, each being a KDTree of its own.
+
+A query visits the shards closest first and skips every shard whose bounding
+box is farther than the farthest neighbor found so far, then merges what the
+shards found. The radius and box searches only visit the shards whose box
+meets the query.
+
+A forest is saved as a small text manifest holding the bounds and point count
+of every shard, and one binary tree file per shard. Loading can map only some
+of the shards, so that several processes on one machine each own a part of the
+forest. The bounds of the other shards are still known, which tells a process
+which others may hold a closer point: "shardDistance" works for every shard,
+loaded or not, and the results of several processes merge by distance.
+
+Operations include:
+
+- build the forest on several threads from an in-memory list of points
+- insert and remove points, a point going to the shard whose box is closest
+- save the forest, the shards being written on several threads
+- load the forest, mapping all of its shards or a chosen subset
+- Query the k closest neighbors of a point or of a batch of points
+- Query every point within a radius or inside an axis aligned box
+- tell the bounds and the distance to a query of every shard
+
+*/
+/******************************************************************************/
+
+#pragma once
+#include "KDTree.h"
+#include <memory>
+#include <vector>
+#include <string>
+#include <utility>
+#include <thread>
+#include <limits>
+#include <sstream>
+#include <iomanip>
+
+template <typename T, unsigned int Dim = 0, typename Metric = L2Metric<T> >
+class ShardedKDTree
+{
+public:
+	typedef KDTree<T, Dim, Metric> Tree;
+	typedef typename Tree::Point Point;
+	typedef typename Tree::Neighbor Neighbor;
+
+	ShardedKDTree();
+	ShardedKDTree(unsigned int dim, unsigned int bucket = 16, const Metric& distanceMetric = Metric());
+	void setSplitRule(SplitRule rule);
+	bool build(const T* points, size_t pointCount, unsigned int shardCount, unsigned int threadCount = 0);
+	bool build(const T* points, size_t pointCount, unsigned int shardCount, ThreadPool& pool);
+	bool insertNewNode(const Point& newData);
+	bool remove(const Point& data);
+	void clear();
+	bool serialize(const std::string& filename, const std::string& location = "", unsigned int threadCount = 0) const;
+	bool deSerialize(const std::string& filename, const std::string& location = "", bool verifyChecksum = true);
+	bool deSerialize(const std::string& filename, const std::string& location, const std::vector<unsigned int>& owned, bool verifyChecksum = true);
+	std::vector<Neighbor> knn(const T* query, size_t k) const;
+	std::vector<Neighbor> knn(const Point& query, size_t k) const;
+	void knnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, unsigned int threadCount = 0) const;
+	void knnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, ThreadPool& pool) const;
+	size_t radiusSearch(const T* query, T radius, std::vector<Neighbor>& result) const;
+	size_t boxSearch(const T* low, const T* high, std::vector<const T*>& result) const;
+	unsigned int shardCount() const;
+	const Tree* shard(unsigned int index) const;
+	size_t shardSize(unsigned int index) const;
+	const T* shardLow(unsigned int index) const;
+	const T* shardHigh(unsigned int index) const;
+	T shardDistance(unsigned int index, const T* query) const;
+	size_t size() const;
+private:
+	//! one tree of the forest. "tree" is null for a shard left to another process, its bounds and point count are still known.
+	struct Shard
+	{
+		std::unique_ptr<Tree> tree;
+		size_t pointCount;
+		//! bounding box of the points of the shard, bounds included.
+		std::vector<T> low;
+		std::vector<T> high;
+	};
+
+	//! rows in [first, last) the partition still has to cut into "count" shards, numbered from "firstShard".
+	struct PendingPartition
+	{
+		size_t first;
+		size_t last;
+		unsigned int firstShard;
+		unsigned int count;
+	};
+
+	//! neighbor found in a shard with its reduced distance, which the shards are compared and the results merged by.
+	struct Candidate
+	{
+		T reduced;
+		Neighbor neighbor;
+	};
+
+	ShardedKDTree(const ShardedKDTree&);
+	ShardedKDTree& operator=(const ShardedKDTree&);
+
+	Tree* newTree() const;
+	void partition(const T* points, std::vector<size_t>& rows, std::vector<size_t>& starts, ThreadPool& pool) const;
+	T boxDistance(const Shard& currShard, const T* query, T* closest) const;
+	bool inside(const Shard& currShard, const T* data) const;
+	std::string shardFile(const std::string& filename, unsigned int index) const;
+	static std::string boundsToString(const std::vector<T>& bounds);
+	static bool closer(const Candidate& lhs, const Candidate& rhs);
+
+	std::vector<Shard> shards;
+	const unsigned int dimension;
+	Metric metric;
+	//! points per leaf and split rule of the shards built by this forest. Loaded shards keep those of their file.
+	unsigned int bucketSize;
+	SplitRule splitRule;
+};
+
+
+template <typename T, unsigned int Dim, typename Metric>
+ShardedKDTree<T, Dim, Metric>::ShardedKDTree() : dimension(Dim), metric(), bucketSize(16), splitRule(SPLIT_CYCLE)
+{
+}
+
+/******************************************************************************/
+/*!
+
+Makes an empty forest whose shards have "dim" dimensions, hold up to "bucket"
+points per leaf and search with "distanceMetric". For a fixed dimension forest
+"dim" is ignored.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+ShardedKDTree<T, Dim, Metric>::ShardedKDTree(unsigned int dim, unsigned int bucket, const Metric& distanceMetric) : dimension(Dim != 0 ? Dim : dim), metric(distanceMetric), bucketSize(bucket != 0 ? bucket : 1), splitRule(SPLIT_CYCLE)
+{
+}
+
+/******************************************************************************/
+/*!
+
+Sets the split rule of the shards built from then on. The top level splits
+cutting the points into shards always use the most spread out dimension.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void ShardedKDTree<T, Dim, Metric>::setSplitRule(SplitRule rule)
+{
+	splitRule = rule;
+}
+
+/******************************************************************************/
+/*!
+
+Builds the forest out of "pointCount" points stored row by row, replacing its
+content. The points are cut into "shardCount" shards, fewer if there are fewer
+points, and the shards are built on "threadCount" threads, all the hardware
+threads if it is 0. Returns false if there are no points or no shards.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool ShardedKDTree<T, Dim, Metric>::build(const T* points, size_t pointCount, unsigned int shardCount, unsigned int threadCount)
+{
+	ThreadPool pool(threadCount);
+	return build(points, pointCount, shardCount, pool);
+}
+
+/******************************************************************************/
+/*!
+
+Same as above on the threads of an existing pool.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool ShardedKDTree<T, Dim, Metric>::build(const T* points, size_t pointCount, unsigned int shardCount, ThreadPool& pool)
+{
+	if (pointCount == 0 || shardCount == 0 || dimension == 0)
+	{
+		std::cout << "a forest needs points, shards and dimensions" << std::endl;
+		return false;
+	}
+	clear();
+	shardCount = static_cast<unsigned int>(std::min<size_t>(shardCount, pointCount));
+	std::vector<size_t> rows(pointCount);
+	for (size_t i = 0; i < pointCount; ++i)
+	{
+		rows[i] = i;
+	}
+	std::vector<size_t> starts(shardCount + 1, pointCount);
+	partition(points, rows, starts, pool);
+
+	shards.resize(shardCount);
+	std::vector<char> built(shardCount, 0);
+	const size_t stride = dimension;
+	pool.parallelFor(shardCount, 1, [this, points, stride, &rows, &starts, &built](size_t begin, size_t end)
+	{
+		std::vector<T> source;
+		for (size_t i = begin; i < end; ++i)
+		{
+			Shard& currShard = shards[i];
+			currShard.pointCount = starts[i + 1] - starts[i];
+			source.resize(currShard.pointCount * stride);
+			for (size_t j = 0; j < currShard.pointCount; ++j)
+			{
+				const T* currData = points + rows[starts[i] + j] * stride;
+				std::copy(currData, currData + stride, source.begin() + j * stride);
+			}
+			currShard.low.assign(source.begin(), source.begin() + stride);
+			currShard.high = currShard.low;
+			for (size_t j = 1; j < currShard.pointCount; ++j)
+			{
+				const T* currData = &source[j * stride];
+				for (size_t a = 0; a < stride; ++a)
+				{
+					currShard.low[a] = std::min(currShard.low[a], currData[a]);
+					currShard.high[a] = std::max(currShard.high[a], currData[a]);
+				}
+			}
+			currShard.tree.reset(newTree());
+			built[i] = currShard.tree->build(source.data(), currShard.pointCount) ? 1 : 0;
+		}
+	});
+	if (std::find(built.begin(), built.end(), 0) != built.end())
+	{
+		clear();
+		return false;
+	}
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Helper function of "build". Sorts "rows" so that shard i holds the rows from
+starts[i] to starts[i + 1]. A range of rows going to n shards is cut at the
+median of its most spread out dimension, the left part getting n / 2 shards and
+a matching share of the rows, so all the shards get about as many points. The
+ranges of one level of cuts are independent and are cut on the threads of
+"pool".
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void ShardedKDTree<T, Dim, Metric>::partition(const T* points, std::vector<size_t>& rows, std::vector<size_t>& starts, ThreadPool& pool) const
+{
+	const size_t stride = dimension;
+	std::vector<PendingPartition> level(1);
+	level[0].first = 0;
+	level[0].last = rows.size();
+	level[0].firstShard = 0;
+	level[0].count = static_cast<unsigned int>(starts.size() - 1);
+	std::vector<PendingPartition> nextLevel;
+	while (!level.empty())
+	{
+		nextLevel.assign(level.size() * 2, PendingPartition());
+		pool.parallelFor(level.size(), 1, [points, stride, &rows, &starts, &level, &nextLevel](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; ++i)
+			{
+				const PendingPartition& range = level[i];
+				starts[range.firstShard] = range.first;
+				nextLevel[2 * i].count = 0;
+				nextLevel[2 * i + 1].count = 0;
+				if (range.count < 2)
+					continue;
+				std::vector<T> low(points + rows[range.first] * stride, points + rows[range.first] * stride + stride);
+				std::vector<T> high(low);
+				for (size_t j = range.first + 1; j < range.last; ++j)
+				{
+					const T* currData = points + rows[j] * stride;
+					for (size_t a = 0; a < stride; ++a)
+					{
+						low[a] = std::min(low[a], currData[a]);
+						high[a] = std::max(high[a], currData[a]);
+					}
+				}
+				size_t axis = 0;
+				for (size_t a = 1; a < stride; ++a)
+				{
+					if (high[a] - low[a] > high[axis] - low[axis])
+						axis = a;
+				}
+				// every shard gets at least one row, as there are at least as many rows as shards
+				const unsigned int leftCount = range.count / 2;
+				const size_t middle = range.first + static_cast<size_t>(static_cast<double>(range.last - range.first) * leftCount / range.count);
+				std::nth_element(rows.begin() + range.first, rows.begin() + middle, rows.begin() + range.last, [points, stride, axis](size_t lhs, size_t rhs)
+				{
+					return points[lhs * stride + axis] < points[rhs * stride + axis];
+				});
+				PendingPartition left = { range.first, middle, range.firstShard, leftCount };
+				PendingPartition right = { middle, range.last, range.firstShard + leftCount, range.count - leftCount };
+				nextLevel[2 * i] = left;
+				nextLevel[2 * i + 1] = right;
+			}
+		});
+		level.clear();
+		for (size_t i = 0; i < nextLevel.size(); ++i)
+		{
+			if (nextLevel[i].count != 0)
+				level.push_back(nextLevel[i]);
+		}
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Inserts a point in the loaded shard whose box is the closest to it, growing
+the box if needed. An empty forest gets a first shard. Returns false if no
+shard of the forest is loaded.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool ShardedKDTree<T, Dim, Metric>::insertNewNode(const Point& newData)
+{
+	if (newData.size() < dimension)
+	{
+		std::cout << "invalid point, expected " << dimension << " values" << std::endl;
+		return false;
+	}
+	const T* data = &newData[0];
+	if (shards.empty())
+	{
+		shards.resize(1);
+		shards[0].tree.reset(newTree());
+		shards[0].pointCount = 0;
+		shards[0].low.assign(data, data + dimension);
+		shards[0].high = shards[0].low;
+	}
+	std::vector<T> closest(dimension);
+	size_t target = shards.size();
+	T best = T();
+	for (size_t i = 0; i < shards.size(); ++i)
+	{
+		if (!shards[i].tree)
+			continue;
+		T distance = boxDistance(shards[i], data, closest.data());
+		if (target == shards.size() || distance < best)
+		{
+			target = i;
+			best = distance;
+		}
+	}
+	if (target == shards.size())
+	{
+		std::cout << "no shard of the forest is loaded" << std::endl;
+		return false;
+	}
+	Shard& currShard = shards[target];
+	for (unsigned int a = 0; a < dimension; ++a)
+	{
+		currShard.low[a] = std::min(currShard.low[a], data[a]);
+		currShard.high[a] = std::max(currShard.high[a], data[a]);
+	}
+	currShard.tree->insertNewNode(newData);
+	++currShard.pointCount;
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Removes one point equal to "data" from the first loaded shard holding it. The
+box of the shard is left as it is, it still holds all of its points. Returns
+false if no loaded shard holds the point.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool ShardedKDTree<T, Dim, Metric>::remove(const Point& data)
+{
+	if (data.size() < dimension)
+	{
+		std::cout << "invalid point, expected " << dimension << " values" << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < shards.size(); ++i)
+	{
+		if (shards[i].tree && inside(shards[i], &data[0]) && shards[i].tree->remove(data))
+		{
+			--shards[i].pointCount;
+			return true;
+		}
+	}
+	return false;
+}
+
+/******************************************************************************/
+/*!
+
+Destroys every shard, unmapping the files of the loaded ones.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void ShardedKDTree<T, Dim, Metric>::clear()
+{
+	std::vector<Shard>().swap(shards);
+}
+
+/******************************************************************************/
+/*!
+
+Saves the forest. "filename" receives the manifest: a "shards,<dimension>,
+<shard count>" line followed by one "shard,<point count>,<low>,<high>" line per
+shard, the two corners of its box written with enough digits to read back
+exactly.
+Shard i is written in the binary format of KDTree to "filename.i", the shards
+being written on "threadCount" threads. Every shard must be loaded.
+
+filename - this is the name of the manifest, extension included.
+location - location to save the manifest and the shards.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool ShardedKDTree<T, Dim, Metric>::serialize(const std::string& filename, const std::string& location, unsigned int threadCount) const
+{
+	if (shards.empty())
+	{
+		std::cout << "Tree is empty " << std::endl;
+		return false;
+	}
+	std::vector<std::string> data;
+	data.push_back("shards," + std::to_string(dimension) + "," + std::to_string(shards.size()));
+	for (size_t i = 0; i < shards.size(); ++i)
+	{
+		if (!shards[i].tree)
+		{
+			std::cout << "shard " << i << " is not loaded, only a whole forest can be saved" << std::endl;
+			return false;
+		}
+		std::vector<T> bounds(shards[i].low);
+		bounds.insert(bounds.end(), shards[i].high.begin(), shards[i].high.end());
+		data.push_back("shard," + std::to_string(shards[i].pointCount) + "," + boundsToString(bounds));
+	}
+	std::vector<char> written(shards.size(), 0);
+	ThreadPool pool(threadCount);
+	pool.parallelFor(shards.size(), 1, [this, &filename, &location, &written](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			// a shard emptied by removals has no file
+			written[i] = shards[i].pointCount == 0 || shards[i].tree->serializeBinary(shardFile(filename, static_cast<unsigned int>(i)), location) ? 1 : 0;
+		}
+	});
+	if (std::find(written.begin(), written.end(), 0) != written.end())
+	{
+		return false;
+	}
+	return FileIO::getInstance().openFiletoWrite(location + filename, "", data);
+}
+
+/******************************************************************************/
+/*!
+
+Loads a forest saved by "serialize", mapping the files of all its shards on
+several threads. The current content of the forest is replaced.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool ShardedKDTree<T, Dim, Metric>::deSerialize(const std::string& filename, const std::string& location, bool verifyChecksum)
+{
+	std::vector<unsigned int> all;
+	return deSerialize(filename, location, all, verifyChecksum);
+}
+
+/******************************************************************************/
+/*!
+
+Same as above, mapping only the shards listed in "owned", all of them if it is
+empty. The other shards are left to other processes: only their bounds and
+point counts are read, their queries return nothing from them. Process p of P
+sharing a forest can for example own the shards p, p + P, p + 2P and so on.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+bool ShardedKDTree<T, Dim, Metric>::deSerialize(const std::string& filename, const std::string& location, const std::vector<unsigned int>& owned, bool verifyChecksum)
+{
+	std::vector<std::string> data = FileIO::getInstance().readFile(location + filename);
+	if (data.empty() || data[0].compare(0, 7, "shards,") != 0)
+	{
+		std::cout << "invalid forest file " << location + filename << std::endl;
+		return false;
+	}
+	const char* header = data[0].c_str() + 7;
+	char* next = nullptr;
+	unsigned long fileDimension = std::strtoul(header, &next, 10);
+	unsigned long count = *next == ',' ? std::strtoul(next + 1, nullptr, 10) : 0;
+	if (fileDimension != dimension || count == 0 || count != data.size() - 1)
+	{
+		std::cout << "incompatible forest file " << location + filename << std::endl;
+		return false;
+	}
+	clear();
+	shards.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const std::string& line = data[i + 1];
+		size_t comma = line.find(',', 6);
+		std::vector<T> bounds;
+		if (line.compare(0, 6, "shard,") == 0 && comma != std::string::npos)
+		{
+			bounds = utilities<T>::stringToData(line.substr(comma + 1));
+		}
+		if (bounds.size() != 2 * static_cast<size_t>(dimension))
+		{
+			std::cout << "corrupted forest file " << location + filename << std::endl;
+			clear();
+			return false;
+		}
+		shards[i].pointCount = static_cast<size_t>(std::strtoull(line.c_str() + 6, nullptr, 10));
+		shards[i].low.assign(bounds.begin(), bounds.begin() + dimension);
+		shards[i].high.assign(bounds.begin() + dimension, bounds.end());
+	}
+	std::vector<unsigned int> loading(owned);
+	if (loading.empty())
+	{
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			loading.push_back(i);
+		}
+	}
+	for (size_t i = 0; i < loading.size(); ++i)
+	{
+		if (loading[i] >= count)
+		{
+			std::cout << "the forest has no shard " << loading[i] << std::endl;
+			clear();
+			return false;
+		}
+	}
+	std::vector<char> loaded(loading.size(), 0);
+	ThreadPool pool(static_cast<unsigned int>(std::min<size_t>(loading.size(), std::thread::hardware_concurrency())));
+	pool.parallelFor(loading.size(), 1, [this, &filename, &location, &loading, &loaded, verifyChecksum](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			Shard& currShard = shards[loading[i]];
+			currShard.tree.reset(newTree());
+			loaded[i] = currShard.pointCount == 0 || currShard.tree->deSerialize(shardFile(filename, loading[i]), location, verifyChecksum) ? 1 : 0;
+		}
+	});
+	if (std::find(loaded.begin(), loaded.end(), 0) != loaded.end())
+	{
+		clear();
+		return false;
+	}
+	return true;
+}
+
+/******************************************************************************/
+/*!
+
+Returns the k closest neighbors of "query" found in the loaded shards, closest
+first. The shards are searched from the closest box to the farthest, and the
+search stops at the first box farther than the k-th neighbor found so far. The
+shards after the first only look for points closer than that neighbor.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+std::vector<typename ShardedKDTree<T, Dim, Metric>::Neighbor> ShardedKDTree<T, Dim, Metric>::knn(const T* query, size_t k) const
+{
+	std::vector<Neighbor> result;
+	if (k == 0)
+	{
+		return result;
+	}
+	// the loaded shards by the reduced distance to their box, closest first
+	std::vector<T> closest(dimension);
+	std::vector<std::pair<T, size_t> > order;
+	for (size_t i = 0; i < shards.size(); ++i)
+	{
+		if (shards[i].tree && shards[i].pointCount != 0)
+			order.push_back(std::make_pair(boxDistance(shards[i], query, closest.data()), i));
+	}
+	std::sort(order.begin(), order.end());
+	std::vector<Candidate> best;
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		if (best.size() == k && !(order[i].first < best.back().reduced))
+			break;
+		// once k neighbors are found, a shard is only searched for points closer than the farthest of them
+		const Tree& currTree = *shards[order[i].second].tree;
+		std::vector<Neighbor> found = best.size() == k ? currTree.knn(query, k, metric.fromReduced(best.back().reduced)) : currTree.knn(query, k);
+		for (size_t j = 0; j < found.size(); ++j)
+		{
+			// the reduced distances compare exactly, the distances may be rounded
+			Candidate candidate;
+			candidate.reduced = metric.template distance<Dim>(query, found[j].point, dimension);
+			candidate.neighbor = found[j];
+			best.push_back(candidate);
+		}
+		std::sort(best.begin(), best.end(), closer);
+		if (best.size() > k)
+			best.resize(k);
+	}
+	result.reserve(best.size());
+	for (size_t i = 0; i < best.size(); ++i)
+	{
+		result.push_back(best[i].neighbor);
+	}
+	return result;
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+std::vector<typename ShardedKDTree<T, Dim, Metric>::Neighbor> ShardedKDTree<T, Dim, Metric>::knn(const Point& query, size_t k) const
+{
+	if (query.size() < dimension)
+	{
+		std::cout << "invalid query, expected " << dimension << " values" << std::endl;
+		return std::vector<Neighbor>();
+	}
+	return knn(&query[0], k);
+}
+
+/******************************************************************************/
+/*!
+
+Finds the k closest neighbors of every query of a batch, laid out as for
+"KDTree::knnBatch", on "threadCount" threads, all the hardware threads if it
+is 0.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void ShardedKDTree<T, Dim, Metric>::knnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, unsigned int threadCount) const
+{
+	ThreadPool pool(threadCount);
+	knnBatch(queries, queryCount, k, results, pool);
+}
+
+/******************************************************************************/
+/*!
+
+Same as above on the threads of an existing pool.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void ShardedKDTree<T, Dim, Metric>::knnBatch(const T* queries, size_t queryCount, size_t k, Neighbor* results, ThreadPool& pool) const
+{
+	if (k == 0)
+	{
+		return;
+	}
+	const size_t stride = dimension;
+	size_t grain = queryCount / (static_cast<size_t>(pool.size()) * 16);
+	grain = std::max<size_t>(1, std::min<size_t>(grain, 256));
+	pool.parallelFor(queryCount, grain, [this, queries, k, results, stride](size_t begin, size_t end)
+	{
+		Neighbor missing;
+		missing.point = nullptr;
+		missing.distance = std::numeric_limits<T>::max();
+		for (size_t i = begin; i < end; ++i)
+		{
+			std::vector<Neighbor> closest = knn(queries + i * stride, k);
+			Neighbor* slots = results + i * k;
+			std::copy(closest.begin(), closest.end(), slots);
+			std::fill(slots + closest.size(), slots + k, missing);
+		}
+	});
+}
+
+/******************************************************************************/
+/*!
+
+Appends every point of the loaded shards whose distance to the query is at most
+"radius" to the result and returns how many points were appended. Only the
+shards whose box is within the radius are searched.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+size_t ShardedKDTree<T, Dim, Metric>::radiusSearch(const T* query, T radius, std::vector<Neighbor>& result) const
+{
+	std::vector<T> closest(dimension);
+	const T reducedRadius = metric.toReduced(radius);
+	size_t found = 0;
+	for (size_t i = 0; i < shards.size(); ++i)
+	{
+		if (shards[i].tree && shards[i].pointCount != 0 && !(reducedRadius < boxDistance(shards[i], query, closest.data())))
+		{
+			found += shards[i].tree->radiusSearch(query, radius, result);
+		}
+	}
+	return found;
+}
+
+/******************************************************************************/
+/*!
+
+Appends every point of the loaded shards inside the axis aligned box [low, high]
+to the result and returns how many points were appended. Only the shards whose
+box meets the query box are searched.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+size_t ShardedKDTree<T, Dim, Metric>::boxSearch(const T* low, const T* high, std::vector<const T*>& result) const
+{
+	size_t found = 0;
+	for (size_t i = 0; i < shards.size(); ++i)
+	{
+		if (!shards[i].tree || shards[i].pointCount == 0)
+			continue;
+		bool meets = true;
+		for (unsigned int a = 0; a < dimension && meets; ++a)
+		{
+			meets = low[a] <= shards[i].high[a] && shards[i].low[a] <= high[a];
+		}
+		if (meets)
+		{
+			found += shards[i].tree->boxSearch(low, high, result);
+		}
+	}
+	return found;
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+unsigned int ShardedKDTree<T, Dim, Metric>::shardCount() const
+{
+	return static_cast<unsigned int>(shards.size());
+}
+
+/******************************************************************************/
+/*!
+
+Returns shard "index", or a null pointer if it is not loaded by this process.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+const typename ShardedKDTree<T, Dim, Metric>::Tree* ShardedKDTree<T, Dim, Metric>::shard(unsigned int index) const
+{
+	return shards[index].tree.get();
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+size_t ShardedKDTree<T, Dim, Metric>::shardSize(unsigned int index) const
+{
+	return shards[index].pointCount;
+}
+
+/******************************************************************************/
+/*!
+
+Return the lowest and highest corners of the box of shard "index", "dimension"
+values each. They are known whether the shard is loaded or not.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+const T* ShardedKDTree<T, Dim, Metric>::shardLow(unsigned int index) const
+{
+	return shards[index].low.data();
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+const T* ShardedKDTree<T, Dim, Metric>::shardHigh(unsigned int index) const
+{
+	return shards[index].high.data();
+}
+
+/******************************************************************************/
+/*!
+
+Returns the distance from "query" to the box of shard "index", 0 inside it. No
+point of the shard is closer, so a process holding neighbors closer than that
+does not need to ask the process owning the shard.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+T ShardedKDTree<T, Dim, Metric>::shardDistance(unsigned int index, const T* query) const
+{
+	std::vector<T> closest(dimension);
+	return metric.fromReduced(boxDistance(shards[index], query, closest.data()));
+}
+
+/******************************************************************************/
+/*!
+
+Returns the number of points of the forest, those of the shards left to other
+processes included.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+size_t ShardedKDTree<T, Dim, Metric>::size() const
+{
+	size_t total = 0;
+	for (size_t i = 0; i < shards.size(); ++i)
+	{
+		total += shards[i].pointCount;
+	}
+	return total;
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+typename ShardedKDTree<T, Dim, Metric>::Tree* ShardedKDTree<T, Dim, Metric>::newTree() const
+{
+	Tree* tree = new Tree(dimension, bucketSize, metric);
+	tree->setSplitRule(splitRule);
+	return tree;
+}
+
+/******************************************************************************/
+/*!
+
+Returns the reduced distance from "query" to the box of a shard, writing the
+point of the box closest to the query to "closest".
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+T ShardedKDTree<T, Dim, Metric>::boxDistance(const Shard& currShard, const T* query, T* closest) const
+{
+	for (unsigned int a = 0; a < dimension; ++a)
+	{
+		closest[a] = std::min(std::max(query[a], currShard.low[a]), currShard.high[a]);
+	}
+	return metric.template distance<Dim>(query, closest, dimension);
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+bool ShardedKDTree<T, Dim, Metric>::inside(const Shard& currShard, const T* data) const
+{
+	for (unsigned int a = 0; a < dimension; ++a)
+	{
+		if (data[a] < currShard.low[a] || currShard.high[a] < data[a])
+			return false;
+	}
+	return true;
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+std::string ShardedKDTree<T, Dim, Metric>::shardFile(const std::string& filename, unsigned int index) const
+{
+	return filename + "." + std::to_string(index);
+}
+
+/******************************************************************************/
+/*!
+
+Writes the corners of a shard box for the manifest, with enough digits that
+every value reads back exactly. A box rounded inward would leave its own
+boundary points outside, and the searches would skip them.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+std::string ShardedKDTree<T, Dim, Metric>::boundsToString(const std::vector<T>& bounds)
+{
+	std::ostringstream ss;
+	ss << std::setprecision(std::numeric_limits<T>::max_digits10);
+	for (size_t i = 0; i < bounds.size(); ++i)
+	{
+		ss << (i != 0 ? "," : "") << bounds[i];
+	}
+	return ss.str();
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+bool ShardedKDTree<T, Dim, Metric>::closer(const Candidate& lhs, const Candidate& rhs)
+{
+	return lhs.reduced < rhs.reduced;
+}
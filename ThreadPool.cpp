@@ -0,0 +1,214 @@
+/******************************************************************************/
+/*!
+\file   ThreadPool.cpp
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+#include "ThreadPool.h"
+
+/******************************************************************************/
+/*!
+
+Starts the worker threads. A thread count of 0 uses one thread per hardware
+thread. The calling thread counts as one of them, so a count of 1 runs every
+loop on the caller and starts no thread.
+
+*/
+/******************************************************************************/
+ThreadPool::ThreadPool(unsigned int threadCount) : currentTask(nullptr), generation(0), activeWorkers(0), pendingRanges(0), stopping(false)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0)
+			threadCount = 1;
+	}
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		queues.push_back(std::unique_ptr<Queue>(new Queue));
+	}
+	threads.reserve(threadCount - 1);
+	for (unsigned int i = 0; i + 1 < threadCount; ++i)
+	{
+		threads.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Wakes up the workers so they can leave and waits for them.
+
+*/
+/******************************************************************************/
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (unsigned int i = 0; i < threads.size(); ++i)
+	{
+		threads[i].join();
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Returns the number of threads running a loop, the calling thread included.
+
+*/
+/******************************************************************************/
+unsigned int ThreadPool::size() const
+{
+	return static_cast<unsigned int>(queues.size());
+}
+
+/******************************************************************************/
+/*!
+
+Runs "task" over [0, count) in chunks of "grain" iterations and returns once
+every chunk is done. Neighboring chunks are dealt to the same thread, so each
+thread starts on a contiguous part of the loop.
+
+*/
+/******************************************************************************/
+void ThreadPool::parallelFor(size_t count, size_t grain, const Task& task)
+{
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = 1;
+	if (threads.empty() || count <= grain)
+	{
+		task(0, count);
+		return;
+	}
+	std::lock_guard<std::mutex> loopGuard(loopLock);
+	size_t rangeCount = (count + grain - 1) / grain;
+	size_t rangesPerQueue = (rangeCount + queues.size() - 1) / queues.size();
+	// a late worker of the previous loop may pick up a chunk as soon as it is queued, so the task is set first
+	pendingRanges.store(rangeCount);
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		currentTask = &task;
+	}
+	for (size_t i = 0; i < rangeCount; ++i)
+	{
+		Range range;
+		range.begin = i * grain;
+		range.end = range.begin + grain < count ? range.begin + grain : count;
+		Queue& queue = *queues[i / rangesPerQueue];
+		std::lock_guard<std::mutex> guard(queue.lock);
+		// the owner pops from the back, pushing to the front keeps it on the start of its part
+		queue.ranges.push_front(range);
+	}
+	{
+		std::lock_guard<std::mutex> guard(stateLock);
+		++generation;
+	}
+	wake.notify_all();
+	drain(static_cast<unsigned int>(queues.size() - 1));
+	// the workers must be done with the task before it goes out of scope
+	std::unique_lock<std::mutex> guard(stateLock);
+	while (pendingRanges.load() != 0 || activeWorkers != 0)
+	{
+		finished.wait(guard);
+	}
+	currentTask = nullptr;
+}
+
+/******************************************************************************/
+/*!
+
+Body of the worker threads. They sleep until a new loop starts, help with it
+and go back to sleep.
+
+*/
+/******************************************************************************/
+void ThreadPool::workerLoop(unsigned int index)
+{
+	unsigned long long seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> guard(stateLock);
+			while (!stopping && seenGeneration == generation)
+			{
+				wake.wait(guard);
+			}
+			if (stopping)
+				return;
+			seenGeneration = generation;
+			++activeWorkers;
+		}
+		drain(index);
+		{
+			std::lock_guard<std::mutex> guard(stateLock);
+			--activeWorkers;
+		}
+		finished.notify_all();
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Takes the next chunk for thread "index", first from its own queue and then
+from the queues of the others. Returns false when no chunk is left anywhere.
+
+*/
+/******************************************************************************/
+bool ThreadPool::popRange(unsigned int index, Range& range)
+{
+	{
+		Queue& own = *queues[index];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (!own.ranges.empty())
+		{
+			range = own.ranges.back();
+			own.ranges.pop_back();
+			return true;
+		}
+	}
+	for (unsigned int i = 1; i < queues.size(); ++i)
+	{
+		Queue& victim = *queues[(index + i) % queues.size()];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.ranges.empty())
+		{
+			range = victim.ranges.front();
+			victim.ranges.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+/******************************************************************************/
+/*!
+
+Runs chunks until none is left.
+
+*/
+/******************************************************************************/
+void ThreadPool::drain(unsigned int index)
+{
+	Range range;
+	while (popRange(index, range))
+	{
+		(*currentTask)(range.begin, range.end);
+		if (pendingRanges.fetch_sub(1) == 1)
+		{
+			std::lock_guard<std::mutex> guard(stateLock);
+			finished.notify_all();
+		}
+	}
+}
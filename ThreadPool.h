@@ -0,0 +1,83 @@
+/******************************************************************************/
+/*!
+\file   ThreadPool.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\class ThreadPool
+\brief
+ThreadPool keeps a fixed set of worker threads alive and runs loops over them.
+A loop is cut into chunks which are dealt out to one queue per thread. Every
+thread works through its own queue from the back and, once it is empty, steals
+chunks from the front of the other queues, so uneven chunks do not leave
+threads idle. The thread calling "parallelFor" takes part in the work.
+
+Operations include:
+
+- run a function over [0, count) in chunks on all the threads.
+- report the number of threads taking part in a loop.
+
+*/
+/******************************************************************************/
+
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class ThreadPool
+{
+public:
+	//! a task receives the half open range [begin, end) of the loop it has to run.
+	typedef std::function<void(size_t begin, size_t end)> Task;
+
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+	unsigned int size() const;
+	void parallelFor(size_t count, size_t grain, const Task& task);
+private:
+	struct Range
+	{
+		size_t begin;
+		size_t end;
+	};
+	//! chunks waiting to be run by one thread. Other threads steal from the front.
+	struct Queue
+	{
+		std::mutex lock;
+		std::deque<Range> ranges;
+	};
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+	void workerLoop(unsigned int index);
+	bool popRange(unsigned int index, Range& range);
+	void drain(unsigned int index);
+
+	std::vector<std::thread> threads;
+	//! one queue per worker thread plus the last one for the calling thread.
+	std::vector<std::unique_ptr<Queue> > queues;
+	//! only one loop runs at a time.
+	std::mutex loopLock;
+	std::mutex stateLock;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	const Task* currentTask;
+	unsigned long long generation;
+	unsigned int activeWorkers;
+	std::atomic<size_t> pendingRanges;
+	bool stopping;
+};
@@ -0,0 +1,105 @@
+/******************************************************************************/
+/*!
+\file   TraversalStack.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\class TraversalStack
+\brief
+TraversalStack holds the nodes a tree traversal still has to visit, in place of
+the call stack of a recursive function. The first "Capacity" entries are kept
+in an array inside the object, so a traversal living on the call stack does not
+allocate as long as the tree is not deeper than that. Deeper trees spill the
+extra entries to the heap instead of overflowing the call stack.
+
+Operations include:
+
+- push an entry
+- pop the last entry pushed
+- tell whether the stack is empty
+
+*/
+/******************************************************************************/
+
+#pragma once
+#include <vector>
+#include <cstddef>
+
+template <typename Entry, size_t Capacity>
+class TraversalStack
+{
+public:
+	TraversalStack();
+	void push(const Entry& entry);
+	Entry pop();
+	bool empty() const;
+	size_t size() const;
+private:
+	TraversalStack(const TraversalStack&);
+	TraversalStack& operator=(const TraversalStack&);
+
+	Entry fixed[Capacity];
+	//! entries past the first "Capacity" ones, only used by trees deeper than expected.
+	std::vector<Entry> overflow;
+	size_t count;
+};
+
+
+template <typename Entry, size_t Capacity>
+TraversalStack<Entry, Capacity>::TraversalStack() : count(0)
+{
+}
+
+template <typename Entry, size_t Capacity>
+inline void TraversalStack<Entry, Capacity>::push(const Entry& entry)
+{
+	if (count < Capacity)
+	{
+		fixed[count] = entry;
+	}
+	else
+	{
+		overflow.push_back(entry);
+	}
+	++count;
+}
+
+/******************************************************************************/
+/*!
+
+Removes the last entry pushed and returns it. The stack must not be empty.
+
+*/
+/******************************************************************************/
+template <typename Entry, size_t Capacity>
+inline Entry TraversalStack<Entry, Capacity>::pop()
+{
+	--count;
+	if (count < Capacity)
+	{
+		return fixed[count];
+	}
+	Entry entry = overflow.back();
+	overflow.pop_back();
+	return entry;
+}
+
+template <typename Entry, size_t Capacity>
+inline bool TraversalStack<Entry, Capacity>::empty() const
+{
+	return count == 0;
+}
+
+template <typename Entry, size_t Capacity>
+inline size_t TraversalStack<Entry, Capacity>::size() const
+{
+	return count;
+}
@@ -0,0 +1,277 @@
+/******************************************************************************/
+/*!
+\file   VersionedKDTree.h
+\author Unni Nair
+\par    email: u.nair@digipen.edu
+\par    KDTree
+\date   10/17/2026
+
+*/
+/******************************************************************************/
+
+
+/******************************************************************************/
+/*!
+\class VersionedKDTree
+\brief
+VersionedKDTree lets queries run while the tree is modified. The tree is kept
+as a series of immutable versions. A reader takes a snapshot, a shared pointer
+to the current version, and queries it for as long as it wants without any
+lock: nothing it can see ever changes.
+
+Writers queue their insertions, removals and updates. "publish" applies the
+queued changes to a copy of the current version and swaps the copy in with one
+atomic store, so the cost of copying the flat arrays is paid once per batch
+and not once per change. That copy is O(n) for a tree of n points, mapped
+trees included: the copy shares the mapping but is moved to memory by its
+first change. A batch is therefore only published on its own once it holds
+at least n / publishFraction changes, which keeps the copy to a constant
+number of points per change as the tree grows. A version is freed by the last
+snapshot releasing it, the reference count of the shared pointer plays the
+part of the grace period of an RCU scheme: a version is never freed while a
+reader still holds it.
+
+Operations include:
+
+- take a snapshot of the current version, never blocking
+- queue insertions, removals and updates of points
+- publish the queued changes as a new version, on demand or once the batch
+  holds "batchSize" changes and a fraction of the points
+- replace the whole tree, for example after rebuilding it from a file
+
+*/
+/******************************************************************************/
+
+#pragma once
+#include "KDTree.h"
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <vector>
+
+template <typename T, unsigned int Dim = 0, typename Metric = L2Metric<T> >
+class VersionedKDTree
+{
+public:
+	typedef KDTree<T, Dim, Metric> Tree;
+	typedef typename Tree::Point Point;
+	//! read handle on one version of the tree. The version stays alive and unchanged as long as the handle is held.
+	typedef std::shared_ptr<const Tree> Snapshot;
+
+	VersionedKDTree(const Tree& initial, size_t batch = 1024);
+	Snapshot snapshot() const;
+	void insert(const Point& newData);
+	void remove(const Point& data);
+	void update(const Point& oldData, const Point& newData);
+	size_t publish();
+	void replace(const Tree& tree);
+	size_t pending() const;
+private:
+	//! change queued by a writer until the next version is published.
+	struct Change
+	{
+		enum Kind
+		{
+			INSERT,
+			REMOVE,
+			UPDATE
+		};
+		Kind kind;
+		Point oldData;
+		Point newData;
+	};
+
+	//! a batch is published on its own once it holds at least this fraction of the points, so the copy is amortized.
+	static constexpr size_t publishFraction = 64;
+
+	VersionedKDTree(const VersionedKDTree&);
+	VersionedKDTree& operator=(const VersionedKDTree&);
+	void queue(const Change& change);
+
+	//! version seen by the readers, only accessed through atomic_load and atomic_store.
+	std::shared_ptr<const Tree> current;
+	//! smallest batch published on its own, 0 to publish only on demand.
+	const size_t batchSize;
+	//! guards "changes" and "pointCount", held only for the time it takes to queue or take a change.
+	mutable std::mutex changeLock;
+	std::vector<Change> changes;
+	//! points of the current version, which sets how large a batch must be before it is worth a copy.
+	size_t pointCount;
+	//! one version is built at a time, so that none is lost.
+	std::mutex publishLock;
+};
+
+
+template <typename T, unsigned int Dim, typename Metric>
+VersionedKDTree<T, Dim, Metric>::VersionedKDTree(const Tree& initial, size_t batch) : current(std::make_shared<const Tree>(initial)), batchSize(batch), pointCount(initial.stats().pointCount)
+{
+}
+
+/******************************************************************************/
+/*!
+
+Returns the current version of the tree. This never waits for a writer.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+typename VersionedKDTree<T, Dim, Metric>::Snapshot VersionedKDTree<T, Dim, Metric>::snapshot() const
+{
+	return std::atomic_load(&current);
+}
+
+/******************************************************************************/
+/*!
+
+Queues the insertion of a point. It is seen by the snapshots taken once the
+batch holding it is published.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void VersionedKDTree<T, Dim, Metric>::insert(const Point& newData)
+{
+	Change change;
+	change.kind = Change::INSERT;
+	change.newData = newData;
+	queue(change);
+}
+
+/******************************************************************************/
+/*!
+
+Queues the removal of one point equal to "data".
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void VersionedKDTree<T, Dim, Metric>::remove(const Point& data)
+{
+	Change change;
+	change.kind = Change::REMOVE;
+	change.oldData = data;
+	queue(change);
+}
+
+/******************************************************************************/
+/*!
+
+Queues moving one point equal to "oldData" to "newData".
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void VersionedKDTree<T, Dim, Metric>::update(const Point& oldData, const Point& newData)
+{
+	Change change;
+	change.kind = Change::UPDATE;
+	change.oldData = oldData;
+	change.newData = newData;
+	queue(change);
+}
+
+template <typename T, unsigned int Dim, typename Metric>
+void VersionedKDTree<T, Dim, Metric>::queue(const Change& change)
+{
+	bool full = false;
+	{
+		std::lock_guard<std::mutex> guard(changeLock);
+		changes.push_back(change);
+		full = batchSize != 0 && changes.size() >= std::max(batchSize, pointCount / publishFraction);
+	}
+	if (full)
+	{
+		publish();
+	}
+}
+
+/******************************************************************************/
+/*!
+
+Applies the queued changes to a copy of the current version and publishes the
+copy. The copy costs O(n) whatever the size of the batch, so calling this for
+a few changes on a large tree stalls the writer. Writers can keep queueing
+changes meanwhile, they go to the next batch.
+Returns how many changes took effect: removing or updating a point the tree
+does not hold does nothing.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+size_t VersionedKDTree<T, Dim, Metric>::publish()
+{
+	std::lock_guard<std::mutex> publishGuard(publishLock);
+	std::vector<Change> batch;
+	{
+		std::lock_guard<std::mutex> guard(changeLock);
+		batch.swap(changes);
+	}
+	if (batch.empty())
+	{
+		return 0;
+	}
+	std::shared_ptr<Tree> next = std::make_shared<Tree>(*std::atomic_load(&current));
+	size_t applied = 0;
+	size_t inserted = 0;
+	size_t removed = 0;
+	for (size_t i = 0; i < batch.size(); ++i)
+	{
+		const Change& change = batch[i];
+		if (change.kind == Change::INSERT)
+		{
+			next->insertNewNode(change.newData);
+			++applied;
+			++inserted;
+		}
+		else if (change.kind == Change::REMOVE)
+		{
+			const bool done = next->remove(change.oldData);
+			applied += done ? 1 : 0;
+			removed += done ? 1 : 0;
+		}
+		else
+		{
+			applied += next->update(change.oldData, change.newData) ? 1 : 0;
+		}
+	}
+	std::shared_ptr<const Tree> published = next;
+	std::atomic_store(&current, published);
+	{
+		std::lock_guard<std::mutex> guard(changeLock);
+		pointCount = pointCount + inserted - removed;
+	}
+	return applied;
+}
+
+/******************************************************************************/
+/*!
+
+Publishes a copy of "tree" as the new version. Changes still queued are
+applied to it by the next "publish".
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+void VersionedKDTree<T, Dim, Metric>::replace(const Tree& tree)
+{
+	std::shared_ptr<const Tree> published = std::make_shared<const Tree>(tree);
+	const size_t points = tree.stats().pointCount;
+	std::lock_guard<std::mutex> publishGuard(publishLock);
+	std::atomic_store(&current, published);
+	std::lock_guard<std::mutex> guard(changeLock);
+	pointCount = points;
+}
+
+/******************************************************************************/
+/*!
+
+Returns the number of changes waiting for the next "publish".
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim, typename Metric>
+size_t VersionedKDTree<T, Dim, Metric>::pending() const
+{
+	std::lock_guard<std::mutex> guard(changeLock);
+	return changes.size();
+}
@@ -21,26 +21,40 @@ Operations include:
 - using Eucledian function it calculates distance between 2 point.
 - convert given data into a string which can be later used to write onto a file
 - converts a string value to desired data to perform manipulations
+- parses one number in place from a range of characters
 
 */
 /******************************************************************************/
 
 #pragma once
+#include "DistanceKernel.h"
 #include <vector>
 #include <sstream>
 #include <iomanip>
 #include <math.h>
 #include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <cstdlib>
+#if defined(__has_include)
+#if __has_include(<charconv>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#include <charconv>
+#endif
+#endif
 
 template<typename T>
 class utilities
 {
 public:
-	static T distance(std::vector<T>, std::vector<T>);
+	static T distance(const std::vector<T>& p1, const std::vector<T>& p2);
+	static T distance(const T* p1, const T* p2, unsigned int size);
+	static T squaredDistance(const T* p1, const T* p2, unsigned int size);
 	static const std::string dataTostring(const std::vector<T>& data);
 	static const std::string dataTostring(const T& data);
 	static const std::vector<T> stringToData(const std::string& data);
+	static const char* parseValue(const char* first, const char* last, T& value);
 private:
+	static const char* convert(const char* first, const char* last, T& value);
 	utilities();
 	~utilities();
 
@@ -55,17 +69,43 @@ This fucntion calculates the distance between 2 point.
 /******************************************************************************/
 
 template <typename T>
-T utilities<T>::distance(std::vector<T> p1, std::vector<T> p2)
+T utilities<T>::distance(const std::vector<T>& p1, const std::vector<T>& p2)
 {
-	T distance = 0;
-	for (unsigned int i = 0; i < p1.size(); ++i)
-	{
-		distance = distance + (p1[i] - p2[i]) * (p1[i] - p2[i]);
-	}
-	T result = static_cast<T>(sqrt(distance));
+	return distance(p1.data(), p2.data(), static_cast<unsigned int>(p1.size()));
+}
+
+
+/******************************************************************************/
+/*!
+
+This fucntion calculates the distance between 2 points of "size" coordinates
+stored in contiguous memory.
+
+*/
+/******************************************************************************/
+
+template <typename T>
+T utilities<T>::distance(const T* p1, const T* p2, unsigned int size)
+{
+	T result = static_cast<T>(sqrt(squaredDistance(p1, p2, size)));
 	return result;
 }
 
+/******************************************************************************/
+/*!
+
+This fucntion calculates the squared distance between 2 points. It is cheaper
+than "distance" and orders points the same way, so comparisons should use it.
+
+*/
+/******************************************************************************/
+
+template <typename T>
+T utilities<T>::squaredDistance(const T* p1, const T* p2, unsigned int size)
+{
+	return DistanceKernel::squared(p1, p2, size);
+}
+
 
 /******************************************************************************/
 /*!
@@ -169,25 +209,112 @@ data can be
 template <typename T>
 const std::vector<T> utilities<T>::stringToData(const std::string& line)
 {
-	std::string value;
-	value.append(line);
-	size_t pos = 0;
 	std::vector<T> result;
-	while (pos != std::string::npos)
+	const char* first = line.data();
+	const char* last = first + line.size();
+	// every value is parsed in place, the line is walked through once
+	for (;;)
 	{
-		if (pos == 0)
-			value = value.substr(pos, std::string::npos);
-		else
-			value = value.substr(pos + 1, std::string::npos);
-		pos = value.find(",");
-		std::stringstream stream(value);
-		T temp;
-		stream >> temp;
+		T temp = T();
+		parseValue(first, last, temp);
 		result.push_back(temp);
+		first = std::find(first, last, ',');
+		if (first == last)
+			break;
+		++first;
 	}
 	return result;
 }
 
+/******************************************************************************/
+/*!
+
+Parses the number at the start of [first, last) into "value". Blanks around the
+number and a leading '+' are skipped. Returns a pointer past the number and the
+blanks following it, or nullptr if no number could be read. Nothing is copied
+or allocated.
+
+*/
+/******************************************************************************/
+template <typename T>
+const char* utilities<T>::parseValue(const char* first, const char* last, T& value)
+{
+	while (first != last && (*first == ' ' || *first == '\t'))
+		++first;
+	if (first != last && *first == '+')
+		++first;
+	first = convert(first, last, value);
+	if (first == nullptr)
+		return nullptr;
+	while (first != last && (*first == ' ' || *first == '\t' || *first == '\r'))
+		++first;
+	return first;
+}
+
+/******************************************************************************/
+/*!
+
+Converts the number at the start of [first, last) with std::from_chars. Older
+compilers without it go through the C library on a small copy of the number,
+as the range is not null terminated.
+
+*/
+/******************************************************************************/
+template <typename T>
+const char* utilities<T>::convert(const char* first, const char* last, T& value)
+{
+#ifdef __cpp_lib_to_chars
+	std::from_chars_result result = std::from_chars(first, last, value);
+	if (result.ec != std::errc())
+		return nullptr;
+	return result.ptr;
+#else
+	char buffer[128];
+	size_t length = std::min<size_t>(static_cast<size_t>(last - first), sizeof(buffer) - 1);
+	std::copy(first, first + length, buffer);
+	buffer[length] = '\0';
+	char* end = buffer;
+	if (std::is_floating_point<T>::value)
+		value = static_cast<T>(strtold(buffer, &end));
+	else if (std::is_signed<T>::value)
+		value = static_cast<T>(strtoll(buffer, &end, 10));
+	else
+		value = static_cast<T>(strtoull(buffer, &end, 10));
+	if (end == buffer)
+		return nullptr;
+	return first + (end - buffer);
+#endif
+}
+
+/******************************************************************************/
+/*!
+\class FixedDistance
+\brief
+Squared Eucledian distance between 2 points whose dimension is known at compile
+time. The recursion on Dim is resolved by the compiler, which leaves one
+unrolled expression without any loop or size check.
+
+*/
+/******************************************************************************/
+template <typename T, unsigned int Dim>
+struct FixedDistance
+{
+	static T squared(const T* p1, const T* p2)
+	{
+		T diff = p1[Dim - 1] - p2[Dim - 1];
+		return FixedDistance<T, Dim - 1>::squared(p1, p2) + diff * diff;
+	}
+};
+
+template <typename T>
+struct FixedDistance<T, 0>
+{
+	static T squared(const T*, const T*)
+	{
+		return 0;
+	}
+};
+
 template <typename T>
 utilities<T>::utilities()
 {